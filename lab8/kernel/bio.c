@@ -1,22 +1,44 @@
 // kernel/bio.c
 #include "types.h"
+#include "param.h"
+#include "riscv.h"
 #include "defs.h"
+#include "proc.h"
 #include "fs.h"
+#include "iosched.h"
 #include "spinlock.h"
 #include "printf.h"
 
-// Simple in-memory disk simulation and minimal buffer cache.
-#define NBLOCKS 1024
-static uchar disk[NBLOCKS * BSIZE];
+// Minimal buffer cache on top of the virtio disk (virtio_disk.c).
 
-static struct buf bufs[16];
+// 元数据（inode、间接块、位图等）经过 bufs 缓存；文件数据由 pcache.c 缓存，
+// 直接以页为缓冲区提交块请求，与磁盘交换整块。
+static struct buf bufs[NBUF];
+static uchar bufdata[NBUF][BSIZE];
 static int g_cache_hits = 0;
 static int g_cache_misses = 0;
 static int g_disk_reads = 0;
 static int g_disk_writes = 0;
 
+// 异步块 I/O：bio_submit 只把 buf 放入 I/O 调度队列（iosched.c），
+// bio_flush 时由调度策略决定下发顺序，并把块号相邻、方向相同的 buf
+// 合并成一个多段 virtio 请求；设备完成后在中断（或轮询）上下文中
+// 逐个标记 iodone 并调用 end_io。队列深度达到 BIO_BATCH 时自动下发。
+#define BIO_BATCH 16
+
+static struct spinlock bio_lock;
+
+// 缓存元数据（dev/blockno/refcnt/lastuse）由 bcache_lock 保护，磁盘 I/O 在锁外进行
+static struct spinlock bcache_lock;
+static uint bcache_tick = 0;
+
 void binit(void)
 {
+    virtio_disk_init();
+    initlock(&bio_lock, "bio");
+    initlock(&bcache_lock, "bcache");
+    bcache_tick = 0;
+    iosched_init();
     for (int i = 0; i < (int)(sizeof(bufs) / sizeof(bufs[0])); i++)
     {
         bufs[i].valid = 0;
@@ -24,75 +46,262 @@ void binit(void)
         bufs[i].dev = 0;
         bufs[i].blockno = 0;
         bufs[i].refcnt = 0;
+        bufs[i].lastuse = 0;
+        bufs[i].data = bufdata[i];
+        bufs[i].iodone = 0;
+        bufs[i].end_io = 0;
+        bufs[i].qnext = 0;
         initlock(&bufs[i].lock, "buf");
     }
 }
 
+// 准备一个不属于缓存的临时 buf，缓冲区为调用者提供的 BSIZE 字节（如页缓存页）
+void bio_initbuf(struct buf *b, uint blockno, void *data)
+{
+    b->valid = 1;
+    b->disk = 0;
+    b->dev = 0;
+    b->blockno = blockno;
+    b->refcnt = 0;
+    b->data = (uchar *)data;
+    b->iodone = 0;
+    b->end_io = 0;
+    b->qnext = 0;
+}
+
+// 设备完成一个（可能合并的）请求：逐块标记完成并回调
+static void bio_endio(struct vreq *r)
+{
+    struct buf *b = (struct buf *)r->arg;
+    while (b)
+    {
+        struct buf *next = b->qnext;
+        b->qnext = 0;
+        acquire(&bio_lock);
+        iosched_complete(b);
+        release(&bio_lock);
+        b->iodone = 1;
+        if (b->end_io)
+            b->end_io(b);
+        wakeup(b);
+        b = next;
+    }
+}
+
+// 异步提交一个块请求，立即返回；end_io 在完成时被调用（中断上下文，不得睡眠）
+void bio_submit(struct buf *b, int op, void (*end_io)(struct buf *))
+{
+    if (b->blockno >= virtio_disk_nblocks())
+        panic("bio_submit: blockno out of range");
+
+    b->op = op;
+    b->end_io = end_io;
+    b->iodone = 0;
+
+    acquire(&bio_lock);
+    int depth = iosched_add(b);
+    if (op == BIO_READ)
+        g_disk_reads++;
+    else
+        g_disk_writes++;
+    release(&bio_lock);
+
+    if (depth >= BIO_BATCH)
+        bio_flush();
+}
+
+// 下发队列中的全部请求，顺序与合并由 I/O 调度器决定
+void bio_flush(void)
+{
+    for (;;)
+    {
+        acquire(&bio_lock);
+        struct buf *head = iosched_dispatch();
+        if (head == 0)
+        {
+            release(&bio_lock);
+            break;
+        }
+        release(&bio_lock);
+
+        // 不持有 bio_lock 下发，virtio_disk_submit 可能等待空闲描述符
+        struct vreq *r = &head->req;
+        r->blockno = head->blockno;
+        r->nseg = 0;
+        r->write = head->op == BIO_WRITE;
+        r->callback = bio_endio;
+        r->arg = head;
+        for (struct buf *b = head; b; b = b->qnext)
+            r->data[r->nseg++] = b->data;
+        virtio_disk_submit(r);
+    }
+}
+
+// 等待 buf 上的 I/O 完成：能睡眠时睡在 buf 上，否则轮询设备
+void bio_wait(struct buf *b)
+{
+    int can_sleep = myproc() != 0 && intr_get();
+
+    bio_flush();
+    acquire(&bio_lock);
+    while (!b->iodone)
+    {
+        if (can_sleep)
+        {
+            sleep(b, &bio_lock);
+        }
+        else
+        {
+            release(&bio_lock);
+            virtio_disk_intr();
+            acquire(&bio_lock);
+        }
+    }
+    release(&bio_lock);
+}
+
+// 磁盘块读写：单块同步请求
+void disk_read(uint blockno, void *dst)
+{
+    struct buf b;
+    bio_initbuf(&b, blockno, dst);
+    bio_submit(&b, BIO_READ, 0);
+    bio_wait(&b);
+}
+
+void disk_write(uint blockno, void *src)
+{
+    struct buf b;
+    bio_initbuf(&b, blockno, src);
+    bio_submit(&b, BIO_WRITE, 0);
+    bio_wait(&b);
+}
+
+// 查找缓存中的块，不论是否仍有引用：已释放但内容有效的块同样命中。
+// valid 为 0 而 refcnt 非 0 的 buf 正在读入，也算命中，由调用者等待读完
 static struct buf *findbuf(uint dev, uint blockno)
 {
     for (int i = 0; i < (int)(sizeof(bufs) / sizeof(bufs[0])); i++)
     {
-        if (bufs[i].refcnt > 0 && bufs[i].dev == dev && bufs[i].blockno == blockno)
+        if ((bufs[i].valid || bufs[i].refcnt > 0) && bufs[i].dev == dev && bufs[i].blockno == blockno)
             return &bufs[i];
     }
     return 0;
 }
 
+// 取最久未使用的无引用 buf；有引用（含日志钉住、正在读入）的 buf 不会被回收
+static struct buf *lrubuf(void)
+{
+    struct buf *victim = 0;
+    for (int i = 0; i < (int)(sizeof(bufs) / sizeof(bufs[0])); i++)
+    {
+        if (bufs[i].refcnt != 0)
+            continue;
+        if (!bufs[i].valid)
+            return &bufs[i];
+        if (victim == 0 || bufs[i].lastuse < victim->lastuse)
+            victim = &bufs[i];
+    }
+    return victim;
+}
+
+// 读入完成（中断或轮询上下文）：内容有效，bio_endio 随后唤醒等待者
+static void bread_endio(struct buf *b)
+{
+    b->valid = 1;
+}
+
+// 等待 b 读入完成，调用者持有 bcache_lock 且持有 b 的引用，返回时仍持有锁
+static void bread_wait(struct buf *b)
+{
+    while (!b->valid)
+    {
+        if (cansleep())
+        {
+            sleep(b, &bcache_lock);
+            continue;
+        }
+        release(&bcache_lock);
+        bio_flush();
+        virtio_disk_intr();
+        acquire(&bcache_lock);
+    }
+}
+
 struct buf *bread(uint dev, uint blockno)
 {
-    if (blockno >= NBLOCKS)
+    if (blockno >= virtio_disk_nblocks())
     {
         panic("bread: blockno out of range");
     }
+    acquire(&bcache_lock);
     struct buf *b = findbuf(dev, blockno);
     if (b)
     {
         g_cache_hits++;
         b->refcnt++;
+        bread_wait(b); // 可能是别人刚发起、尚未完成的读
+        release(&bcache_lock);
         return b;
     }
-    // allocate free buf
-    for (int i = 0; i < (int)(sizeof(bufs) / sizeof(bufs[0])); i++)
-    {
-        if (bufs[i].refcnt == 0)
-        {
-            b = &bufs[i];
-            b->dev = dev;
-            b->blockno = blockno;
-            b->refcnt = 1;
-            b->valid = 1;
-            b->disk = 0;
-            // copy from disk
-            memmove(b->data, &disk[blockno * BSIZE], BSIZE);
-            g_cache_misses++;
-            g_disk_reads++;
-            return b;
-        }
-    }
-    panic("bread: no free buffers");
-    return 0;
+    b = lrubuf();
+    if (b == 0)
+        panic("bread: no free buffers");
+    b->dev = dev;
+    b->blockno = blockno;
+    b->refcnt = 1;
+    b->valid = 0; // 读入中：只能被命中等待，不会被回收
+    b->disk = 0;
+    g_cache_misses++;
+    release(&bcache_lock);
+
+    bio_submit(b, BIO_READ, bread_endio);
+    acquire(&bcache_lock);
+    bread_wait(b);
+    release(&bcache_lock);
+    return b;
 }
 
 void bwrite(struct buf *b)
 {
     if (!b || !b->valid)
         return;
-    // write to simulated disk
-    if (b->blockno >= NBLOCKS)
+    if (b->blockno >= virtio_disk_nblocks())
         panic("bwrite: out of range");
-    memmove(&disk[b->blockno * BSIZE], b->data, BSIZE);
+    bio_submit(b, BIO_WRITE, 0);
+    bio_wait(b);
     b->disk = 0;
-    g_disk_writes++;
 }
 
 void brelse(struct buf *b)
 {
     if (!b)
         return;
+    acquire(&bcache_lock);
     if (b->refcnt <= 0)
         panic("brelse: refcnt");
-    b->refcnt--;
-    // if no refs, keep buffer valid
+    // 无引用后内容仍有效，留在缓存中供后续命中
+    if (--b->refcnt == 0)
+        b->lastuse = ++bcache_tick;
+    release(&bcache_lock);
+}
+
+// 日志登记的块在安装前必须留在缓存中
+void bpin(struct buf *b)
+{
+    acquire(&bcache_lock);
+    b->refcnt++;
+    release(&bcache_lock);
+}
+
+void bunpin(struct buf *b)
+{
+    acquire(&bcache_lock);
+    if (b->refcnt <= 0)
+        panic("bunpin: refcnt");
+    if (--b->refcnt == 0)
+        b->lastuse = ++bcache_tick;
+    release(&bcache_lock);
 }
 
 int buffer_cache_hits(void)
@@ -114,3 +323,17 @@ int disk_write_count(void)
 {
     return g_disk_writes;
 }
+
+int bio_request_count(void)
+{
+    struct iosched_stats st;
+    iosched_get_stats(&st);
+    return st.dispatched;
+}
+
+int bio_merge_count(void)
+{
+    struct iosched_stats st;
+    iosched_get_stats(&st);
+    return st.merges;
+}
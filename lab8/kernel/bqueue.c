@@ -0,0 +1,118 @@
+// kernel/bqueue.c
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "bqueue.h"
+
+// 有界阻塞队列。队列满时生产者等待、为空时消费者等待，等待与通知按条件变量的方式使用：
+// 等待者在 lock 下登记后睡眠，醒来后重新检查条件；通知方只有在登记的等待者不为 0 时
+// 才调用 wakeup（wakeup 要扫描整个进程表）。批量接口一次放入/取出多项，每批只通知一次。
+
+int bq_init(struct bqueue *q, int cap, char *name)
+{
+    if (cap < 1 || cap > BQ_MAXCAP)
+        return -1;
+    if ((q->buf = (uint64 *)alloc_page()) == 0)
+        return -1;
+    initlock(&q->lock, name);
+    q->cap = cap;
+    q->head = 0;
+    q->tail = 0;
+    q->closed = 0;
+    q->nputwait = 0;
+    q->ngetwait = 0;
+    q->wakeups = 0;
+    return 0;
+}
+
+// 调用者保证已没有进程在使用队列
+void bq_destroy(struct bqueue *q)
+{
+    free_page(q->buf);
+    q->buf = 0;
+}
+
+// 等待条件成立：登记为等待者后睡眠在 nwait 上，调用者持有 q->lock 并在返回后复查条件
+static void bq_wait(struct bqueue *q, int *nwait)
+{
+    (*nwait)++;
+    sleep(nwait, &q->lock);
+    (*nwait)--;
+}
+
+// 通知等待者（广播），没有等待者时什么也不做
+static void bq_signal(struct bqueue *q, int *nwait)
+{
+    if (*nwait)
+    {
+        wakeup(nwait);
+        q->wakeups++;
+    }
+}
+
+// 关闭队列：唤醒所有等待者，此后的放入失败，取完剩余项后取出返回 0
+void bq_close(struct bqueue *q)
+{
+    acquire(&q->lock);
+    q->closed = 1;
+    bq_signal(q, &q->nputwait);
+    bq_signal(q, &q->ngetwait);
+    release(&q->lock);
+}
+
+// 放入 n 项，空间不足时放入能放下的部分、通知消费者后等待，直到全部放入。
+// 返回放入的项数；队列已关闭时提前返回，一项都没放入则返回 -1
+int bq_putn(struct bqueue *q, uint64 *v, int n)
+{
+    int done = 0;
+    acquire(&q->lock);
+    while (done < n && !q->closed)
+    {
+        int space = q->cap - (int)(q->tail - q->head);
+        if (space == 0)
+        {
+            bq_wait(q, &q->nputwait);
+            continue;
+        }
+        int m = n - done < space ? n - done : space;
+        for (int i = 0; i < m; i++)
+            q->buf[(q->tail + i) % q->cap] = v[done + i];
+        q->tail += m;
+        done += m;
+        bq_signal(q, &q->ngetwait);
+    }
+    release(&q->lock);
+    return done == 0 && n > 0 ? -1 : done;
+}
+
+// 取出至多 n 项：队列非空时立即取走可取的部分，为空时等待。
+// 返回取出的项数；队列已关闭且为空时返回 0
+int bq_getn(struct bqueue *q, uint64 *v, int n)
+{
+    acquire(&q->lock);
+    while (q->tail == q->head && !q->closed)
+        bq_wait(q, &q->ngetwait);
+    int avail = (int)(q->tail - q->head);
+    int m = n < avail ? n : avail;
+    for (int i = 0; i < m; i++)
+        v[i] = q->buf[(q->head + i) % q->cap];
+    q->head += m;
+    if (m > 0)
+        bq_signal(q, &q->nputwait);
+    release(&q->lock);
+    return m;
+}
+
+int bq_put(struct bqueue *q, uint64 v)
+{
+    return bq_putn(q, &v, 1) == 1 ? 0 : -1;
+}
+
+// 取出一项，队列已关闭且为空时返回 -1
+int bq_get(struct bqueue *q, uint64 *v)
+{
+    return bq_getn(q, v, 1) == 1 ? 0 : -1;
+}
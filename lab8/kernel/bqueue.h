@@ -0,0 +1,32 @@
+// kernel/bqueue.h
+#ifndef BQUEUE_H
+#define BQUEUE_H
+
+#include "types.h"
+#include "spinlock.h"
+
+// 有界阻塞队列：多生产者/多消费者，容量在初始化时指定（至多 BQ_MAXCAP 项）
+struct bqueue
+{
+    struct spinlock lock;
+    uint64 *buf;  // 环形缓冲区（一页）
+    int cap;      // 容量（项）
+    uint head;    // 已取出的项数
+    uint tail;    // 已放入的项数
+    int closed;   // 已关闭：不再接受放入，取空后返回 0
+    int nputwait; // 等待空间的生产者数
+    int ngetwait; // 等待数据的消费者数
+    int wakeups;  // 实际发出的唤醒次数
+};
+
+#define BQ_MAXCAP (PGSIZE / (int)sizeof(uint64))
+
+int bq_init(struct bqueue *q, int cap, char *name);
+void bq_destroy(struct bqueue *q);
+void bq_close(struct bqueue *q);
+int bq_putn(struct bqueue *q, uint64 *v, int n);
+int bq_getn(struct bqueue *q, uint64 *v, int n);
+int bq_put(struct bqueue *q, uint64 v);
+int bq_get(struct bqueue *q, uint64 *v);
+
+#endif
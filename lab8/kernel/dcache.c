@@ -0,0 +1,175 @@
+// kernel/dcache.c
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "printf.h"
+
+// 路径名查找缓存：缓存 (dev, 父目录 inum, 名字) -> 子 inum 的查找结果，
+// inum 为 0 表示负项（名字不存在），同样可以省去一次目录查找。
+// 按哈希桶查找，NDENTRY 项按 LRU 复用。缓存只记录 inum 而不持有 inode 引用，
+// 命中后由 iget 从 inode 缓存取得 inode，因此不会阻止 inode 被淘汰。
+// dirlink/dirunlink 修改目录时更新对应项，inode 被释放时清除与之相关的全部项。
+#define DHASH 31
+
+struct dentry
+{
+    int used;
+    uint dev;
+    uint dinum;           // 父目录
+    char name[DIRSIZ];
+    uint inum;            // 0 = 负项
+    struct dentry *hnext;
+    struct dentry *lru_prev, *lru_next;
+};
+
+static struct
+{
+    struct spinlock lock;
+    struct dentry ent[NDENTRY];
+    struct dentry *hash[DHASH];
+    struct dentry lru; // 哨兵：lru.lru_next 最近使用，lru.lru_prev 最久未用
+} dcache;
+
+static int g_dc_hits = 0;
+static int g_dc_misses = 0;
+
+static uint dhash(uint dev, uint dinum, const char *name)
+{
+    uint h = dev * 131 + dinum;
+    for (int i = 0; i < DIRSIZ && name[i]; i++)
+        h = h * 31 + (uchar)name[i];
+    return h % DHASH;
+}
+
+static void lru_remove(struct dentry *d)
+{
+    d->lru_prev->lru_next = d->lru_next;
+    d->lru_next->lru_prev = d->lru_prev;
+}
+
+static void lru_push(struct dentry *d)
+{
+    d->lru_next = dcache.lru.lru_next;
+    d->lru_prev = &dcache.lru;
+    dcache.lru.lru_next->lru_prev = d;
+    dcache.lru.lru_next = d;
+}
+
+static void hash_remove(struct dentry *d)
+{
+    struct dentry **pp = &dcache.hash[dhash(d->dev, d->dinum, d->name)];
+    while (*pp && *pp != d)
+        pp = &(*pp)->hnext;
+    if (*pp)
+        *pp = d->hnext;
+    d->hnext = 0;
+}
+
+// 作废一项并移到 LRU 末尾，优先被复用；调用者持有 dcache.lock
+static void d_drop(struct dentry *d)
+{
+    hash_remove(d);
+    d->used = 0;
+    lru_remove(d);
+    d->lru_next = &dcache.lru;
+    d->lru_prev = dcache.lru.lru_prev;
+    dcache.lru.lru_prev->lru_next = d;
+    dcache.lru.lru_prev = d;
+}
+
+// 调用者持有 dcache.lock
+static struct dentry *d_find(uint dev, uint dinum, const char *name)
+{
+    for (struct dentry *d = dcache.hash[dhash(dev, dinum, name)]; d; d = d->hnext)
+    {
+        if (d->dev == dev && d->dinum == dinum && strncmp(d->name, name, DIRSIZ) == 0)
+            return d;
+    }
+    return 0;
+}
+
+void dcache_init(void)
+{
+    initlock(&dcache.lock, "dcache");
+    for (int i = 0; i < DHASH; i++)
+        dcache.hash[i] = 0;
+    dcache.lru.lru_next = dcache.lru.lru_prev = &dcache.lru;
+    for (int i = 0; i < NDENTRY; i++)
+    {
+        dcache.ent[i].used = 0;
+        dcache.ent[i].hnext = 0;
+        lru_push(&dcache.ent[i]);
+    }
+    g_dc_hits = 0;
+    g_dc_misses = 0;
+}
+
+// 查找 (dev, dinum, name)：命中返回 1 并在 pinum 中给出子 inum（负项为 0），未命中返回 0
+int dcache_lookup(uint dev, uint dinum, const char *name, uint *pinum)
+{
+    acquire(&dcache.lock);
+    struct dentry *d = d_find(dev, dinum, name);
+    if (d)
+    {
+        lru_remove(d);
+        lru_push(d);
+        *pinum = d->inum;
+        g_dc_hits++;
+    }
+    else
+    {
+        g_dc_misses++;
+    }
+    release(&dcache.lock);
+    return d != 0;
+}
+
+// 记录查找结果（inum 为 0 记为负项），已有项直接更新
+void dcache_enter(uint dev, uint dinum, const char *name, uint inum)
+{
+    acquire(&dcache.lock);
+    struct dentry *d = d_find(dev, dinum, name);
+    if (d == 0)
+    {
+        d = dcache.lru.lru_prev;
+        if (d->used)
+            hash_remove(d);
+        d->used = 1;
+        d->dev = dev;
+        d->dinum = dinum;
+        strncpy(d->name, name, DIRSIZ);
+        uint h = dhash(dev, dinum, d->name);
+        d->hnext = dcache.hash[h];
+        dcache.hash[h] = d;
+    }
+    d->inum = inum;
+    lru_remove(d);
+    lru_push(d);
+    release(&dcache.lock);
+}
+
+// inode 被释放：清除以它为父目录或指向它的全部项，避免 inum 复用后命中旧结果
+void dcache_purge(uint dev, uint inum)
+{
+    acquire(&dcache.lock);
+    for (int i = 0; i < NDENTRY; i++)
+    {
+        struct dentry *d = &dcache.ent[i];
+        if (d->used && d->dev == dev && (d->dinum == inum || d->inum == inum))
+            d_drop(d);
+    }
+    release(&dcache.lock);
+}
+
+int dcache_hits(void)
+{
+    return g_dc_hits;
+}
+
+int dcache_misses(void)
+{
+    return g_dc_misses;
+}
@@ -38,6 +38,8 @@ void pmem_init(void);
 void *alloc_page(void);
 void *alloc_pages(int n);
 void free_page(void *pa);
+void page_ref_inc(void *pa);
+int page_ref_count(void *pa);
 
 // vm.c
 // 页表类型和接口由 vm.h 提供
@@ -68,6 +70,7 @@ void trap_init(void);
 void timer_interrupt_handler(void);
 void enable_interrupts(void);
 void disable_interrupts(void);
+void usertrap(void);
 void usertrapret(void);
 
 // proc.c
@@ -81,6 +84,8 @@ void wakeup(void *chan);
 int kill(int pid);
 int wait(uint64 addr);
 void proc_freepagetable(pagetable_t pagetable, uint64 sz);
+int sched_switches(void);
+int cansleep(void);
 void yield(void);
 void wakeup(void *chan);
 /* minimal cross-file prototypes used by proc.c */
@@ -97,6 +102,44 @@ int create_process(void (*entry)(void));
 void exit_process(int status);
 int wait_process(int *status);
 
+// shm.c
+void shminit(void);
+int shm_open(const char *name, int npages);
+uint64 shm_attach(struct proc *p, int id);
+int shm_detach(struct proc *p, int id);
+void shm_detach_all(struct proc *p);
+int shm_unlink(int id);
+int shm_npages(int id);
+
+// futex.c
+void futexinit(void);
+int futex_wait(pagetable_t pt, uint64 uaddr, int val);
+int futex_wake(pagetable_t pt, uint64 uaddr, int n);
+int futex_wait_count(void);
+
+// mmap.c
+struct inode;
+uint64 mmap_file(struct proc *p, struct inode *ip, uint off, uint64 len, int prot, int flags);
+int munmap_file(struct proc *p, uint64 va, uint64 len);
+void mmap_release(struct proc *p);
+int mmap_fault(struct proc *p, uint64 va, int write);
+
+// virtio_disk.c
+struct vreq;
+void virtio_disk_init(void);
+void virtio_disk_submit(struct vreq *r);
+void virtio_disk_wait(struct vreq *r);
+void virtio_disk_rw(uint blockno, void *data, int write);
+void virtio_disk_intr(void);
+int virtio_disk_max_inflight(void);
+uint virtio_disk_nblocks(void);
+
+// plic.c
+void plicinit(void);
+void plicinithart(void);
+int plic_claim(void);
+void plic_complete(int irq);
+
 // filesystem and buffer cache
 void binit(void);
 struct buf *bread(uint dev, uint blockno);
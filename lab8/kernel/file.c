@@ -4,17 +4,12 @@
 #include "fs.h"
 #include "printf.h" // for panic prototype if needed
 #include "log.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "file.h"
 
-struct file
-{
-    int ref;
-    int readable;
-    int writable;
-    uint off;
-    struct inode *ip;
-};
-
-static struct file filetable[50];
+static struct file filetable[NFILE];
 
 void fileinit(void)
 {
@@ -22,6 +17,7 @@ void fileinit(void)
     {
         filetable[i].ref = 0;
         filetable[i].ip = 0;
+        filetable[i].pipe = 0;
     }
 }
 
@@ -31,15 +27,30 @@ struct file *filealloc(void)
     {
         if (filetable[i].ref == 0)
         {
+            filetable[i].type = FD_NONE;
             filetable[i].ref = 1;
+            filetable[i].readable = 0;
+            filetable[i].writable = 0;
             filetable[i].off = 0;
             filetable[i].ip = 0;
+            filetable[i].pipe = 0;
+            filetable[i].ra_next = 0;
+            filetable[i].ra_window = 0;
+            filetable[i].ra_end = 0;
             return &filetable[i];
         }
     }
     return 0;
 }
 
+struct file *filedup(struct file *f)
+{
+    if (f->ref < 1)
+        panic("filedup");
+    f->ref++;
+    return f;
+}
+
 void fileclose(struct file *f)
 {
     if (f == 0)
@@ -50,18 +61,61 @@ void fileclose(struct file *f)
         panic("fileclose: ref<=0");
     }
     f->ref--;
-    if (f->ref == 0 && f->ip)
+    if (f->ref > 0)
+        return;
+    if (f->type == FD_PIPE)
+    {
+        pipeclose(f->pipe, f->writable);
+        f->pipe = 0;
+    }
+    else if (f->ip)
     {
         klog(LOG_LEVEL_INFO, "fileclose: inum=%d", (int)f->ip->inum);
         iput(f->ip);
         f->ip = 0;
     }
+    f->type = FD_NONE;
+}
+
+// 顺序读检测：本次读取紧接上一次结束处（或从文件头开始）时窗口翻倍，上限 RA_MAXPAGES；
+// 否则视为随机访问并关闭预读。窗口内尚未预读的页交给页缓存提前读入。
+static void file_readahead(struct file *f, int n)
+{
+    if (f->off != f->ra_next)
+    {
+        f->ra_window = 0;
+        f->ra_end = 0;
+        f->ra_next = f->off + n;
+        return;
+    }
+    f->ra_next = f->off + n;
+
+    if (f->ra_window == 0)
+        f->ra_window = RA_INITPAGES;
+    else if (f->ra_window < RA_MAXPAGES)
+        f->ra_window *= 2;
+
+    uint next = (f->off + n + BSIZE - 1) / BSIZE; // 本次读取之后的第一页
+    uint end = next + f->ra_window;
+    uint lastpg = (f->ip->size + BSIZE - 1) / BSIZE;
+    if (end > lastpg)
+        end = lastpg;
+    if (next < f->ra_end)
+        next = f->ra_end;
+    if (next < end)
+    {
+        pcache_readahead(f->ip, next, end - next);
+        f->ra_end = end;
+    }
 }
 
 int fileread(struct file *f, char *addr, int n)
 {
     if (!f || !f->readable)
         return -1;
+    if (f->type == FD_PIPE)
+        return piperead(f->pipe, addr, n);
+    file_readahead(f, n);
     int r = readi(f->ip, addr, f->off, n);
     klog(LOG_LEVEL_DEBUG, "fileread inum=%d off=%d n=%d r=%d", (int)f->ip->inum, (int)f->off, n, r);
     if (r > 0)
@@ -73,9 +127,175 @@ int filewrite(struct file *f, char *addr, int n)
 {
     if (!f || !f->writable)
         return -1;
+    if (f->type == FD_PIPE)
+        return pipewrite(f->pipe, addr, n);
     int w = writei(f->ip, addr, f->off, n);
     klog(LOG_LEVEL_DEBUG, "filewrite inum=%d off=%d n=%d w=%d", (int)f->ip->inum, (int)f->off, n, w);
     if (w > 0)
         f->off += w;
     return w;
 }
+
+// 在指定偏移读写，不使用也不修改 f->off（也不参与顺序预读检测），
+// 多个读者可以共享同一个 file 而无需串行化偏移的更新。管道没有偏移，不支持
+int filepread(struct file *f, char *addr, int n, uint off)
+{
+    if (!f || f->type != FD_INODE || !f->readable || n < 0)
+        return -1;
+    return readi(f->ip, addr, off, n);
+}
+
+int filepwrite(struct file *f, char *addr, int n, uint off)
+{
+    if (!f || f->type != FD_INODE || !f->writable || n < 0)
+        return -1;
+    return writei(f->ip, addr, off, n);
+}
+
+// 分散读：从 f->off 开始依次填满各段缓冲区，遇到文件末尾提前结束，返回总字节数
+int filereadv(struct file *f, struct iovec *iov, int iovcnt)
+{
+    if (!f || !f->readable || iovcnt < 0 || iovcnt > IOV_MAX)
+        return -1;
+    int tot = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        int r = fileread(f, (char *)iov[i].iov_base, iov[i].iov_len);
+        if (r < 0)
+            return tot > 0 ? tot : -1;
+        tot += r;
+        if (r < (int)iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+// 聚集写：把各段缓冲区依次写到 f->off 处，返回总字节数
+int filewritev(struct file *f, struct iovec *iov, int iovcnt)
+{
+    if (!f || !f->writable || iovcnt < 0 || iovcnt > IOV_MAX)
+        return -1;
+    int tot = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        int w = filewrite(f, (char *)iov[i].iov_base, iov[i].iov_len);
+        if (w < 0)
+            return tot > 0 ? tot : -1;
+        tot += w;
+        if (w < (int)iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+extern void consputc(int);
+
+// out 为 0 表示控制台；out 为管道时页缓存数据直接复制进管道的环
+static int sendbuf(struct file *out, char *src, int n)
+{
+    if (out == 0)
+    {
+        for (int i = 0; i < n; i++)
+            consputc(src[i]);
+        return n;
+    }
+    return filewrite(out, src, n);
+}
+
+// 零拷贝发送：把 in 的 [off, off+n) 直接从页缓存页交给 out（文件、管道，为 0 时输出到控制台），
+// 不经过用户空间，也不复制到中间缓冲区；按预读窗口批量读入后续页。返回发送的字节数
+int filesend(struct file *out, struct file *in, uint off, int n)
+{
+    if (!in || in->type != FD_INODE || !in->readable || n < 0 || (out && !out->writable))
+        return -1;
+    struct inode *ip = in->ip;
+    if (off >= ip->size)
+        return 0;
+    if (off + n > ip->size)
+        n = ip->size - off;
+    if (INODE_INLINE(ip))
+        return sendbuf(out, (char *)ip->addrs + off, n);
+
+    uint lastpg = (off + n - 1) / BSIZE;
+    int tot = 0;
+    while (tot < n)
+    {
+        uint pg = (off + tot) / BSIZE;
+        uint boff = (off + tot) % BSIZE;
+        if (tot == 0 || pg % RA_MAXPAGES == 0)
+        {
+            uint npages = lastpg - pg + 1;
+            pcache_readahead(ip, pg, npages < RA_MAXPAGES ? npages : RA_MAXPAGES);
+        }
+        uint64 pa = pcache_get(ip, pg);
+        if (pa == 0)
+            break;
+        // 发送期间持有页面引用，即使缓存项被淘汰页面也不会被释放
+        page_ref_inc((void *)pa);
+        int len = BSIZE - boff;
+        if (len > n - tot)
+            len = n - tot;
+        int w = sendbuf(out, (char *)pa + boff, len);
+        free_page((void *)pa);
+        if (w < 0)
+        {
+            if (tot == 0)
+                tot = -1;
+            break;
+        }
+        tot += w;
+        if (w < len)
+            break;
+    }
+    return tot;
+}
+
+// ---- 进程文件描述符表 ----
+// p->fdmap 的第 i 位表示 fd i 已分配，最小空闲 fd 即第一个为 0 的位。
+
+// 为 f 分配最小的空闲 fd，表满时返回 -1
+int fdalloc(struct proc *p, struct file *f)
+{
+    uint freemap = ~p->fdmap & ((1u << NOFILE) - 1);
+    if (freemap == 0)
+        return -1;
+    int fd = __builtin_ctz(freemap);
+    p->ofile[fd] = f;
+    p->fdmap |= 1u << fd;
+    return fd;
+}
+
+struct file *fdget(struct proc *p, int fd)
+{
+    if (fd < 0 || fd >= NOFILE || !(p->fdmap & (1u << fd)))
+        return 0;
+    return p->ofile[fd];
+}
+
+int fdclose(struct proc *p, int fd)
+{
+    struct file *f = fdget(p, fd);
+    if (f == 0)
+        return -1;
+    p->ofile[fd] = 0;
+    p->fdmap &= ~(1u << fd);
+    fileclose(f);
+    return 0;
+}
+
+// fork：子进程继承父进程的全部 fd，共享同一个 file（及其偏移）
+void fdinherit(struct proc *parent, struct proc *child)
+{
+    child->fdmap = parent->fdmap;
+    for (int fd = 0; fd < NOFILE; fd++)
+        child->ofile[fd] = (parent->fdmap & (1u << fd)) ? filedup(parent->ofile[fd]) : 0;
+}
+
+void fdcloseall(struct proc *p)
+{
+    for (int fd = 0; fd < NOFILE; fd++)
+    {
+        if (p->fdmap & (1u << fd))
+            fdclose(p, fd);
+    }
+}
@@ -0,0 +1,62 @@
+// kernel/file.h
+#ifndef FILE_H
+#define FILE_H
+
+#include "types.h"
+
+struct file
+{
+    enum
+    {
+        FD_NONE,
+        FD_INODE,
+        FD_PIPE
+    } type;
+    int ref;
+    int readable;
+    int writable;
+    uint off;          // FD_INODE
+    struct inode *ip;  // FD_INODE
+    struct pipe *pipe; // FD_PIPE
+    // 顺序读检测与自适应预读（fileread）
+    uint ra_next;   // 顺序读时下一次读取应开始的偏移
+    uint ra_window; // 当前预读窗口（页），0 表示未检测到顺序读
+    uint ra_end;    // 已发起预读的页号上界（不含）
+};
+
+// readv/writev 的一段缓冲区（内核地址）
+struct iovec
+{
+    void *iov_base;
+    uint iov_len;
+};
+
+#define IOV_MAX 16 // max segments per readv/writev
+
+struct proc;
+
+struct file *filealloc(void);
+struct file *filedup(struct file *f);
+void fileclose(struct file *f);
+int fileread(struct file *f, char *addr, int n);
+int filewrite(struct file *f, char *addr, int n);
+int filepread(struct file *f, char *addr, int n, uint off);
+int filepwrite(struct file *f, char *addr, int n, uint off);
+int filereadv(struct file *f, struct iovec *iov, int iovcnt);
+int filewritev(struct file *f, struct iovec *iov, int iovcnt);
+int filesend(struct file *out, struct file *in, uint off, int n);
+int fdalloc(struct proc *p, struct file *f);
+struct file *fdget(struct proc *p, int fd);
+int fdclose(struct proc *p, int fd);
+void fdinherit(struct proc *parent, struct proc *child);
+void fdcloseall(struct proc *p);
+
+// pipe.c
+struct pipe;
+int pipealloc(struct file **rf, struct file **wf);
+void pipeclose(struct pipe *pi, int writable);
+int pipewrite(struct pipe *pi, char *addr, int n);
+int piperead(struct pipe *pi, char *addr, int n);
+int pipe_wakeups(void);
+
+#endif
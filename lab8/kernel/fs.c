@@ -1,5 +1,6 @@
 // kernel/fs.c
 #include "types.h"
+#include "param.h"
 #include "defs.h"
 #include "fs.h"
 #include "spinlock.h"
@@ -11,68 +12,414 @@
 #define IBLOCK(i, sb) ((sb).inodestart + (i) / IPB)
 
 static struct superblock sb;
-static struct inode inodes[200];
 
-void iinit(void)
+// 内存 inode 缓存：NINODE 项，按 (dev, inum) 哈希查找；
+// 引用计数为 0 的项挂在 LRU 链表上，未命中时复用最久未使用的项。
+// 缓存项第一次被 iget 时从磁盘 inode 表读入（valid），修改后由 iupdate 经日志写回。
+#define IHASH 31
+
+static struct
+{
+    struct spinlock lock;
+    struct inode inode[NINODE];
+    struct inode *hash[IHASH];
+    struct inode lru; // 哨兵：lru.lru_next 最近释放，lru.lru_prev 最久未用
+} icache;
+
+// 空闲 inode 位图（内存中），挂载时由磁盘 inode 表的 type 字段重建
+static uchar imap[(NINODES + 7) / 8];
+// 块位图（内存中），挂载时由有效 inode 的块指针重建，置位 = 已用。
+// 大小随磁盘容量变化，按页分配，每页记录 BPP 个块
+#define BPP (PGSIZE * 8)
+#define BMAP_MAXPAGES 8
+static uchar *blkmap[BMAP_MAXPAGES];
+// 已释放但所在事务组尚未提交的块：在 blkmap 中保持置位，提交后才归还。
+// 否则延迟分配可能在释放落盘前复用该块，崩溃后旧 inode 会指向别的文件的数据
+static uchar *freemap[BMAP_MAXPAGES];
+static int g_nfreed = 0;
+static struct spinlock balloc_lock;
+static int g_balloc_calls = 0;
+static int g_icache_hits = 0;
+static int g_icache_misses = 0;
+
+static uint ihash(uint dev, uint inum)
+{
+    return (dev * 131 + inum) % IHASH;
+}
+
+static void lru_remove(struct inode *ip)
+{
+    ip->lru_prev->lru_next = ip->lru_next;
+    ip->lru_next->lru_prev = ip->lru_prev;
+    ip->lru_next = ip->lru_prev = ip;
+}
+
+static void lru_push(struct inode *ip)
+{
+    ip->lru_next = icache.lru.lru_next;
+    ip->lru_prev = &icache.lru;
+    icache.lru.lru_next->lru_prev = ip;
+    icache.lru.lru_next = ip;
+}
+
+static void hash_remove(struct inode *ip)
 {
-    // initialize simple superblock layout on our simulated disk
-    sb.magic = 0x10203040;
-    sb.size = 1024;            // NBLOCKS in bio.c
-    sb.nblocks = sb.size - 10; // simple
-    sb.ninodes = 200;
-    sb.nlog = 0;
+    struct inode **pp = &icache.hash[ihash(ip->dev, ip->inum)];
+    while (*pp && *pp != ip)
+        pp = &(*pp)->hnext;
+    if (*pp)
+        *pp = ip->hnext;
+    ip->hnext = 0;
+}
+
+// 读取第 1 块的超级块；空白磁盘按设备容量格式化（布局写入超级块）。
+// 磁盘末尾 SCRATCHBLOCKS 块不属于文件系统，留给直接读写磁盘的测试
+static void readsb(void)
+{
+    struct buf *bp = bread(0, 1);
+    memmove(&sb, bp->data, sizeof(sb));
+    if (sb.magic == FSMAGIC && sb.size + SCRATCHBLOCKS <= virtio_disk_nblocks())
+    {
+        brelse(bp);
+        return;
+    }
+
+    sb.magic = FSMAGIC;
+    sb.size = virtio_disk_nblocks() - SCRATCHBLOCKS;
+    if (sb.size > BMAP_MAXPAGES * BPP)
+        sb.size = BMAP_MAXPAGES * BPP;
+    sb.ninodes = NINODES;
+    sb.nlog = LOGBLOCKS + 1; // header + log blocks
     sb.logstart = 2;
-    sb.inodestart = 10;
-    sb.bmapstart = sb.inodestart + (sb.ninodes / IPB) + 1;
-    // init in-memory inode table
-    for (int i = 0; i < (int)(sizeof(inodes) / sizeof(inodes[0])); i++)
+    sb.inodestart = sb.logstart + sb.nlog;
+    sb.bmapstart = sb.inodestart + (sb.ninodes + IPB - 1) / IPB;
+    sb.nblocks = sb.size - (sb.bmapstart + 1);
+    memset(bp->data, 0, BSIZE);
+    memmove(bp->data, &sb, sizeof(sb));
+    bwrite(bp);
+    brelse(bp);
+    printf("fs: formatted %d blocks\n", (int)sb.size);
+}
+
+void iinit(void)
+{
+    readsb();
+
+    initlock(&icache.lock, "icache");
+    for (int i = 0; i < IHASH; i++)
+        icache.hash[i] = 0;
+    icache.lru.lru_next = icache.lru.lru_prev = &icache.lru;
+    for (int i = 0; i < NINODE; i++)
     {
-        inodes[i].dev = 0;
-        inodes[i].inum = i;
-        inodes[i].ref = 0;
-        initlock(&inodes[i].lock, "inode");
-        inodes[i].valid = 0;
+        struct inode *ip = &icache.inode[i];
+        ip->dev = 0;
+        ip->inum = 0;
+        ip->ref = 0;
+        initlock(&ip->lock, "inode");
+        ip->valid = 0;
+        ip->pc_root = 0;
+        ip->pc_height = 0;
+        ip->hnext = 0;
+        ip->ndirty = 0;
+        ip->ind_blk = 0;
+        lru_push(ip);
     }
+    g_icache_hits = 0;
+    g_icache_misses = 0;
+    initlock(&balloc_lock, "balloc");
+    g_balloc_calls = 0;
 }
 
+static void bmark(uint b)
+{
+    if (b < sb.size)
+        blkmap[b / BPP][b % BPP / 8] |= 1 << (b % 8);
+}
+
+static int btest(uint b)
+{
+    return blkmap[b / BPP][b % BPP / 8] & (1 << (b % 8));
+}
+
+// 标记间接表 t 及其下 depth 层引用的全部块（depth 为 1 时表项即数据块）
+static void bmark_tree(uint t, int depth)
+{
+    bmark(t);
+    struct buf *bp = bread(0, t);
+    uint *a = (uint *)bp->data;
+    for (int j = 0; j < (int)NINDIRECT; j++)
+    {
+        if (a[j] == 0)
+            continue;
+        if (depth > 1)
+            bmark_tree(a[j], depth - 1);
+        else
+            bmark(a[j]);
+    }
+    brelse(bp);
+}
+
+// 扫描磁盘 inode 表重建 inode 与块的空闲位图（须在日志恢复之后）
+static void imap_init(void)
+{
+    memset(imap, 0, sizeof(imap));
+    imap[0] |= 1; // inode 0 不使用
+    for (uint i = 0; i < (sb.size + BPP - 1) / BPP; i++)
+    {
+        if (blkmap[i] == 0 && (blkmap[i] = (uchar *)alloc_page()) == 0)
+            panic("imap_init: no memory for block bitmap");
+        if (freemap[i] == 0 && (freemap[i] = (uchar *)alloc_page()) == 0)
+            panic("imap_init: no memory for block bitmap");
+        memset(blkmap[i], 0, PGSIZE);
+        memset(freemap[i], 0, PGSIZE);
+    }
+    g_nfreed = 0;
+    for (uint b = 0; b <= sb.bmapstart; b++)
+        bmark(b);
+    for (uint inum = 1; inum < sb.ninodes; inum++)
+    {
+        struct buf *bp = bread(0, IBLOCK(inum, sb));
+        struct dinode *dip = (struct dinode *)bp->data + inum % IPB;
+        if (dip->type != 0)
+        {
+            imap[inum / 8] |= 1 << (inum % 8);
+            if (INODE_INLINE(dip))
+            {
+                brelse(bp);
+                continue;
+            }
+            for (int i = 0; i < NDIRECT; i++)
+                if (dip->addrs[i])
+                    bmark(dip->addrs[i]);
+            for (int l = 1; l <= 3; l++)
+                if (dip->addrs[NDIRECT + l - 1])
+                    bmark_tree(dip->addrs[NDIRECT + l - 1], l);
+        }
+        brelse(bp);
+    }
+}
+
+// 从磁盘 inode 表读入 ip 的内容
+static void iload(struct inode *ip)
+{
+    struct buf *bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    struct dinode *dip = (struct dinode *)bp->data + ip->inum % IPB;
+    ip->type = dip->type;
+    ip->major = dip->major;
+    ip->minor = dip->minor;
+    ip->nlink = dip->nlink;
+    ip->size = dip->size;
+    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    brelse(bp);
+    ip->ind_blk = 0;
+}
+
+// 把内存 inode 的修改写回磁盘 inode 表，须在事务（begin_op/end_op）中调用
+void iupdate(struct inode *ip)
+{
+    struct buf *bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    struct dinode *dip = (struct dinode *)bp->data + ip->inum % IPB;
+    dip->type = ip->type;
+    dip->major = ip->major;
+    dip->minor = ip->minor;
+    dip->nlink = ip->nlink;
+    dip->size = ip->size;
+    memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+    log_write(bp);
+    brelse(bp);
+}
+
+// 等待正在装入的 ip，调用者持有 icache.lock，返回时仍持有
+static void iwait(struct inode *ip)
+{
+    if (cansleep())
+    {
+        sleep(ip, &icache.lock);
+        return;
+    }
+    release(&icache.lock);
+    acquire(&icache.lock);
+}
+
+// 取得 (dev, inum) 的缓存项并增加引用；未缓存时复用 LRU 项并从磁盘读入。
+// 新项先以 valid = 0 插入哈希表再放锁读盘，同一 inode 不会被重复装入；
+// 其他进程查到尚未装入完成的项时等待。
 struct inode *iget(uint dev, uint inum)
 {
-    if (inum >= sb.ninodes)
+    if (inum == 0 || inum >= sb.ninodes)
         return 0;
-    struct inode *ip = &inodes[inum];
-    ip->ref++;
+
+    acquire(&icache.lock);
+    for (struct inode *ip = icache.hash[ihash(dev, inum)]; ip; ip = ip->hnext)
+    {
+        if (ip->dev == dev && ip->inum == inum)
+        {
+            if (ip->ref++ == 0)
+                lru_remove(ip);
+            g_icache_hits++;
+            while (!ip->valid)
+                iwait(ip);
+            release(&icache.lock);
+            return ip;
+        }
+    }
+
+    struct inode *ip = icache.lru.lru_prev;
+    if (ip == &icache.lru)
+        panic("iget: no inodes");
+    lru_remove(ip);
+    if (ip->valid)
+        hash_remove(ip);
+    ip->dev = dev;
+    ip->inum = inum;
+    ip->ref = 1;
+    ip->valid = 0;
+    ip->hnext = icache.hash[ihash(dev, inum)];
+    icache.hash[ihash(dev, inum)] = ip;
+    g_icache_misses++;
+    release(&icache.lock);
+
+    // 复用前丢弃上一个 inode 的缓存数据页
+    pcache_drop(ip);
+    iload(ip);
+    acquire(&icache.lock);
+    ip->valid = 1;
+    wakeup(ip);
+    release(&icache.lock);
     return ip;
 }
 
+static void bfree(uint b);
+
+// 释放间接表 t 及其下 depth 层引用的全部块
+static void bfree_tree(uint t, int depth)
+{
+    struct buf *bp = bread(0, t);
+    uint *a = (uint *)bp->data;
+    for (int j = 0; j < (int)NINDIRECT; j++)
+    {
+        if (a[j] == 0)
+            continue;
+        if (depth > 1)
+            bfree_tree(a[j], depth - 1);
+        else
+            bfree(a[j]);
+    }
+    brelse(bp);
+    bfree(t);
+}
+
+// 释放 inode 的全部数据块，须在事务中调用
+static void itrunc(struct inode *ip)
+{
+    pcache_drop(ip);
+    if (INODE_INLINE(ip))
+    {
+        memset(ip->addrs, 0, sizeof(ip->addrs));
+        ip->size = 0;
+        return;
+    }
+    for (int i = 0; i < NDIRECT; i++)
+    {
+        if (ip->addrs[i])
+        {
+            bfree(ip->addrs[i]);
+            ip->addrs[i] = 0;
+        }
+    }
+    for (int l = 1; l <= 3; l++)
+    {
+        if (ip->addrs[NDIRECT + l - 1])
+        {
+            bfree_tree(ip->addrs[NDIRECT + l - 1], l);
+            ip->addrs[NDIRECT + l - 1] = 0;
+        }
+    }
+    ip->ind_blk = 0;
+    ip->size = 0;
+}
+
+// 释放引用；最后一个引用释放且链接数为 0 时回收 inode 与数据块
 void iput(struct inode *ip)
 {
     if (!ip)
         return;
     if (ip->ref <= 0)
         panic("iput: ref<=0");
-    ip->ref--;
+
+    // 最后一个引用：写回延迟分配的脏页，之后该缓存项可能被复用
+    if (ip->ref == 1 && ip->valid && ip->nlink > 0 && ip->ndirty > 0)
+        iflush(ip);
+
+    if (ip->ref == 1 && ip->valid && ip->nlink == 0 && ip->type != 0)
+    {
+        // 没有其他引用，也不在任何目录中：截断并释放
+        begin_op();
+        itrunc(ip);
+        ip->type = 0;
+        iupdate(ip);
+        end_op();
+        acquire(&icache.lock);
+        imap[ip->inum / 8] &= ~(1 << (ip->inum % 8));
+        release(&icache.lock);
+        dcache_purge(ip->dev, ip->inum);
+    }
+
+    acquire(&icache.lock);
+    if (--ip->ref == 0)
+        lru_push(ip);
+    release(&icache.lock);
 }
 
-struct inode *ialloc(uint dev, short type)
+// 分配一个空闲 inode：在空闲位图中查找，返回已引用的缓存项；须在事务中调用
+static struct inode *ialloc_txn(uint dev, short type)
 {
-    for (uint inum = 1; inum < sb.ninodes; inum++)
+    uint inum = 0;
+
+    acquire(&icache.lock);
+    for (uint i = 0; i < sizeof(imap) && inum == 0; i++)
     {
-        struct inode *ip = &inodes[inum];
-        if (!ip->valid)
+        if (imap[i] == 0xff)
+            continue;
+        for (int bit = 0; bit < 8; bit++)
         {
-            ip->valid = 1;
-            ip->type = type;
-            ip->nlink = 1;
-            ip->size = 0;
-            for (int i = 0; i < NDIRECT + 1; i++)
-                ip->addrs[i] = 0;
-            ip->ref = 1;
-            klog(LOG_LEVEL_INFO, "ialloc: inum=%d type=%d", (int)ip->inum, (int)type);
-            return ip;
+            uint n = i * 8 + bit;
+            if (n < sb.ninodes && !(imap[i] & (1 << bit)))
+            {
+                imap[i] |= 1 << bit;
+                inum = n;
+                break;
+            }
         }
     }
-    klog(LOG_LEVEL_WARN, "ialloc: out of inodes");
-    return 0;
+    release(&icache.lock);
+    if (inum == 0)
+    {
+        klog(LOG_LEVEL_WARN, "ialloc: out of inodes");
+        return 0;
+    }
+
+    struct inode *ip = iget(dev, inum);
+    ip->type = type;
+    ip->major = 0;
+    ip->minor = 0;
+    ip->nlink = 1;
+    ip->size = 0;
+    memset(ip->addrs, 0, sizeof(ip->addrs));
+    ip->ind_blk = 0;
+    // 丢弃该缓存项上一次使用时残留的数据页
+    pcache_drop(ip);
+    iupdate(ip);
+    klog(LOG_LEVEL_INFO, "ialloc: inum=%d type=%d", (int)ip->inum, (int)type);
+    return ip;
+}
+
+struct inode *ialloc(uint dev, short type)
+{
+    begin_op();
+    struct inode *ip = ialloc_txn(dev, type);
+    end_op();
+    return ip;
 }
 
 void ilock(struct inode *ip)
@@ -85,126 +432,244 @@ void iunlock(struct inode *ip)
     release(&ip->lock);
 }
 
-// map logical block to physical block: naive allocation on write
-static uint bmap(struct inode *ip, uint bn)
+// 空闲块：块位图中未置位（已释放但未提交的块仍置位），
+// 且不在日志中等待安装（否则安装会覆盖新内容）
+static int block_is_free(uint b)
 {
-    if (bn < NDIRECT)
+    if (b <= sb.bmapstart || b >= sb.size || btest(b))
+        return 0;
+    return !log_holds(b);
+}
+
+// 分配至多 want 个连续块：从 goal 开始环绕查找，优先第一段长度足够的空闲区，
+// 否则取找到的最长一段。返回首块号，*got 为实际块数；没有空闲块时返回 0
+static uint balloc_run(uint goal, uint want, uint *got)
+{
+    uint first = sb.bmapstart + 1;
+    uint nblk = sb.size - first;
+    uint best = 0, bestlen = 0;
+
+    if (goal < first || goal >= sb.size)
+        goal = first;
+    acquire(&balloc_lock);
+    g_balloc_calls++;
+    for (uint i = 0; i < nblk && bestlen < want;)
     {
-        if (ip->addrs[bn] == 0)
+        uint b = first + (goal - first + i) % nblk;
+        if (!block_is_free(b))
         {
-            // allocate a block: choose first free block after bmapstart
-            for (uint b = sb.bmapstart + 1; b < sb.size; b++)
-            {
-                // very simple free test: scan disk block content for zero
-                struct buf *bb = bread(0, b);
-                int allzero = 1;
-                for (int i = 0; i < BSIZE; i++)
-                    if (bb->data[i])
-                    {
-                        allzero = 0;
-                        break;
-                    }
-                if (allzero)
-                {
-                    ip->addrs[bn] = b;
-                    if (ip->addrs[bn] >= NBLOCKS)
-                    {
-                        printf("bmap direct OOR: bn=%d b=%d NBLOCKS=%d\n", (int)bn, (int)ip->addrs[bn], (int)NBLOCKS);
-                        brelse(bb);
-                        panic("bmap: assigned block out of range");
-                    }
-                    brelse(bb);
-                    return b;
-                }
-                brelse(bb);
-            }
-            panic("bmap: out of blocks");
+            i++;
+            continue;
         }
-        return ip->addrs[bn];
+        uint len = 1;
+        while (len < want && b + len < sb.size && block_is_free(b + len))
+            len++;
+        if (len > bestlen)
+        {
+            best = b;
+            bestlen = len;
+        }
+        i += len;
     }
-    // indirect
-    bn -= NDIRECT;
-    if (ip->addrs[NDIRECT] == 0)
+    for (uint k = 0; k < bestlen; k++)
+        bmark(best + k);
+    release(&balloc_lock);
+    *got = bestlen;
+    if (bestlen == 0)
+        klog(LOG_LEVEL_WARN, "balloc: out of blocks");
+    return best;
+}
+
+static uint balloc(uint goal)
+{
+    uint got;
+    return balloc_run(goal, 1, &got);
+}
+
+// 释放数据块：块内容不必清零。位图暂不清除，只记入 freemap，
+// 由 bfree_commit 在事务组提交后归还给分配器
+static void bfree(uint b)
+{
+    acquire(&balloc_lock);
+    freemap[b / BPP][b % BPP / 8] |= 1 << (b % 8);
+    g_nfreed++;
+    release(&balloc_lock);
+}
+
+// 事务组已持久化：归还其间释放的全部块。由日志在提交后调用，此时没有进行中的操作
+void bfree_commit(void)
+{
+    acquire(&balloc_lock);
+    if (g_nfreed > 0)
     {
-        // allocate indirect block
-        for (uint b = sb.bmapstart + 1; b < sb.size; b++)
+        for (uint i = 0; i < (sb.size + BPP - 1) / BPP; i++)
         {
-            struct buf *bb = bread(0, b);
-            int allzero = 1;
-            for (int i = 0; i < BSIZE; i++)
-                if (bb->data[i])
-                {
-                    allzero = 0;
-                    break;
-                }
-            if (allzero)
+            uint64 *m = (uint64 *)blkmap[i];
+            uint64 *f = (uint64 *)freemap[i];
+            for (int j = 0; j < (int)(PGSIZE / sizeof(uint64)); j++)
             {
-                ip->addrs[NDIRECT] = b;
-                if (ip->addrs[NDIRECT] >= NBLOCKS)
-                {
-                    printf("bmap indir tbl OOR: b=%d NBLOCKS=%d\n", (int)ip->addrs[NDIRECT], (int)NBLOCKS);
-                    brelse(bb);
-                    panic("bmap: indirect table out of range");
-                }
-                brelse(bb);
-                break;
+                m[j] &= ~f[j];
+                f[j] = 0;
             }
-            brelse(bb);
         }
-        if (ip->addrs[NDIRECT] == 0)
-            panic("bmap: out of blocks for indirect");
+        g_nfreed = 0;
     }
-    struct buf *ib = bread(0, ip->addrs[NDIRECT]);
-    uint *a = (uint *)ib->data;
-    if (a[bn] == 0)
+    release(&balloc_lock);
+}
+
+// 分配一个清零的间接表，须在事务中调用
+static uint table_alloc(uint goal)
+{
+    uint t = balloc(goal);
+    if (t == 0)
+        return 0;
+    struct buf *bp = bread(0, t);
+    memset(bp->data, 0, BSIZE);
+    log_write(bp);
+    brelse(bp);
+    return t;
+}
+
+// 取得逻辑块 bn 所在的最末级间接表，*idx 为表内下标。
+// bn 在直接块范围内或表不存在时返回 0；goal 非零时按需分配中间表（须在事务中调用）。
+// 每个 inode 记住上一次用到的最末级表，顺序访问时不必从顶层逐级查找。
+static int g_indcache_hits = 0;
+
+static uint bmap_table(struct inode *ip, uint bn, uint *idx, uint goal)
+{
+    if (bn < NDIRECT)
+        return 0;
+    if (ip->ind_blk && bn - ip->ind_base < NINDIRECT)
+    {
+        g_indcache_hits++;
+        *idx = bn - ip->ind_base;
+        return ip->ind_blk;
+    }
+
+    // 层级 level 的表项覆盖 NINDIRECT^(level-1) 个块
+    uint64 off = bn - NDIRECT, span = NINDIRECT;
+    int level = 1;
+    while (level <= 3 && off >= span)
     {
-        for (uint b = sb.bmapstart + 1; b < sb.size; b++)
+        off -= span;
+        span *= NINDIRECT;
+        level++;
+    }
+    if (level > 3)
+        return 0;
+
+    uint *slot = &ip->addrs[NDIRECT + level - 1];
+    if (*slot == 0 && (goal == 0 || (*slot = table_alloc(goal)) == 0))
+        return 0;
+    uint t = *slot;
+    for (int d = level - 1; d > 0; d--)
+    {
+        span /= NINDIRECT;
+        struct buf *bp = bread(0, t);
+        uint *a = (uint *)bp->data;
+        uint k = (off / span) % NINDIRECT;
+        if (a[k] == 0)
         {
-            struct buf *bb = bread(0, b);
-            int allzero = 1;
-            for (int i = 0; i < BSIZE; i++)
-                if (bb->data[i])
-                {
-                    allzero = 0;
-                    break;
-                }
-            if (allzero)
+            if (goal == 0 || (a[k] = table_alloc(goal)) == 0)
             {
-                // 避免将当前 inode 的间接表块再次当作数据块分配，导致表被文件数据覆盖
-                if (b == ip->addrs[NDIRECT])
-                {
-                    klog(LOG_LEVEL_WARN, "bmap: skipping indirect tbl block=%d", (int)b);
-                    brelse(bb);
-                    continue;
-                }
-                a[bn] = b;
-                bwrite(ib);
-                if (a[bn] >= NBLOCKS)
-                {
-                    printf("bmap indirect OOR: bn=%d b=%d NBLOCKS=%d\n", (int)bn, (int)a[bn], (int)NBLOCKS);
-                    brelse(bb);
-                    brelse(ib);
-                    klog(LOG_LEVEL_FATAL, "bmap: indirect OOR bn=%d b=%d", (int)bn, (int)a[bn]);
-                    panic("bmap: assigned indirect block out of range");
-                }
-                brelse(bb);
-                brelse(ib);
-                return a[bn];
+                brelse(bp);
+                return 0;
             }
-            brelse(bb);
+            log_write(bp);
+        }
+        t = a[k];
+        brelse(bp);
+    }
+    *idx = off % NINDIRECT;
+    ip->ind_base = bn - *idx;
+    ip->ind_blk = t;
+    return t;
+}
+
+// 把逻辑块 bn 映射到磁盘块 b，必要时分配间接表；须在事务中调用
+static int bmap_set(struct inode *ip, uint bn, uint b)
+{
+    if (bn < NDIRECT)
+    {
+        ip->addrs[bn] = b;
+        return 0;
+    }
+    uint idx;
+    uint t = bmap_table(ip, bn, &idx, b);
+    if (t == 0)
+        return -1;
+    struct buf *bp = bread(0, t);
+    ((uint *)bp->data)[idx] = b;
+    log_write(bp);
+    brelse(bp);
+    return 0;
+}
+
+// look up the disk block of logical block bn without allocating; 0 = hole
+uint bmap_peek(struct inode *ip, uint bn)
+{
+    if (INODE_INLINE(ip))
+        return 0;
+    if (bn < NDIRECT)
+        return ip->addrs[bn];
+    uint idx;
+    uint t = bmap_table(ip, bn, &idx, 0);
+    if (t == 0)
+        return 0;
+    struct buf *bp = bread(0, t);
+    uint b = ((uint *)bp->data)[idx];
+    brelse(bp);
+    return b;
+}
+
+int indcache_hits(void)
+{
+    return g_indcache_hits;
+}
+
+// 目录内容不进入页缓存：经缓冲区缓存读取，修改由 dir_write 经日志提交
+static int dir_read(struct inode *dp, char *dst, uint off, uint n)
+{
+    uint tot = 0;
+    while (tot < n)
+    {
+        uint boff = off % BSIZE;
+        uint m = BSIZE - boff;
+        if (m > n - tot)
+            m = n - tot;
+        uint b = bmap_peek(dp, off / BSIZE);
+        if (b == 0)
+        {
+            memset(dst + tot, 0, m);
+        }
+        else
+        {
+            struct buf *bp = bread(dp->dev, b);
+            memmove(dst + tot, bp->data + boff, m);
+            brelse(bp);
         }
-        panic("bmap: out of blocks indirect2");
+        tot += m;
+        off += m;
     }
-    brelse(ib);
-    return a[bn];
+    return tot;
 }
 
+// file data goes through the per-inode page cache (pcache.c); only the
+// indirect block is read through the buf cache, and only on a page cache miss.
+// directories are read through the buf cache (dir_read).
 int readi(struct inode *ip, char *dst, uint off, uint n)
 {
     if (off > ip->size)
         return 0;
     if (off + n > ip->size)
         n = ip->size - off;
+    if (INODE_INLINE(ip))
+    {
+        memmove(dst, (char *)ip->addrs + off, n);
+        return n;
+    }
+    if (ip->type == T_DIR)
+        return dir_read(ip, dst, off, n);
     uint tot = 0;
     while (tot < n)
     {
@@ -213,39 +678,77 @@ int readi(struct inode *ip, char *dst, uint off, uint n)
         uint toread = BSIZE - boff;
         if (toread > n - tot)
             toread = n - tot;
-        uint bnum = 0;
-        if (bn < NDIRECT)
-            bnum = ip->addrs[bn];
-        else
-        {
-            struct buf *ib = bread(0, ip->addrs[NDIRECT]);
-            uint *a = (uint *)ib->data;
-            bnum = a[bn - NDIRECT];
-            brelse(ib);
-        }
-        if (bnum == 0)
-        {
-            // hole
-            for (uint i = 0; i < toread; i++)
-                dst[tot + i] = 0;
-        }
-        else
-        {
-            struct buf *b = bread(0, bnum);
-            memmove(dst + tot, b->data + boff, toread);
-            brelse(b);
-        }
+        if (pcache_read(ip, bn, boff, dst + tot, toread) < 0)
+            break;
         tot += toread;
         off += toread;
     }
     return tot;
 }
 
+// 写回一个有脏页的 inode，为页缓存腾出可淘汰的页；没有脏页可写回时返回 -1
+static int iflush_other(void)
+{
+    struct inode *victim = 0;
+    acquire(&icache.lock);
+    for (struct inode *ip = icache.inode; ip < &icache.inode[NINODE]; ip++)
+    {
+        if (ip->ref > 0 && ip->valid && ip->ndirty > 0)
+        {
+            ip->ref++;
+            victim = ip;
+            break;
+        }
+    }
+    release(&icache.lock);
+    if (victim == 0)
+        return -1;
+    int r = iflush(victim);
+    iput(victim);
+    return r;
+}
+
+// 延迟分配：只把数据写入页缓存并标记为脏，磁盘块在 iflush 时才分配。
+// 全局脏页达到 NDIRTYMAX 时写回本 inode 的脏页。目录只能经 dirlink/dirunlink 修改。
 int writei(struct inode *ip, char *src, uint off, uint n)
 {
-    if (off > ip->size)
+    if (ip->type == T_DIR || off > ip->size || off + n < off || off + n > MAXFILE * BSIZE)
         return -1;
+    if (INODE_INLINE(ip))
+    {
+        if (off + n <= INLINE_MAX)
+        {
+            // 内联文件：只修改 inode，随 inode 块一起经日志提交
+            begin_op();
+            memmove((char *)ip->addrs + off, src, n);
+            if (off + n > ip->size)
+                ip->size = off + n;
+            iupdate(ip);
+            end_op();
+            return n;
+        }
+    }
     uint tot = 0;
+    if (INODE_INLINE(ip))
+    {
+        // 超出内联容量：第 0 页在页缓存中由内联内容填充，再写入本次数据落在第 0 页的部分
+        // （脏页，写回时分配块）。写入成功后才清除内联状态并越过 INLINE_MAX，
+        // 缓存中全是脏页而失败时文件保持原样
+        uint first = BSIZE - off;
+        if (first > n)
+            first = n;
+        pcache_drop(ip);
+        if (pcache_write(ip, 0, off, src, first) < 0)
+        {
+            // 内联文件自身没有脏页：写回其他 inode 腾出缓存后重试
+            if (iflush_other() < 0 || pcache_write(ip, 0, off, src, first) < 0)
+                return -1;
+        }
+        memset(ip->addrs, 0, sizeof(ip->addrs));
+        ip->size = off + first;
+        tot = first;
+        off += first;
+    }
     while (tot < n)
     {
         uint bn = off / BSIZE;
@@ -253,33 +756,624 @@ int writei(struct inode *ip, char *src, uint off, uint n)
         uint towrite = BSIZE - boff;
         if (towrite > n - tot)
             towrite = n - tot;
-        uint bnum = bmap(ip, bn);
-        struct buf *b = bread(0, bnum);
-        memmove(b->data + boff, src + tot, towrite);
-        bwrite(b);
-        brelse(b);
+        if (pcache_write(ip, bn, boff, src + tot, towrite) < 0)
+        {
+            // 缓存中全是脏页：先写回本 inode 再重试
+            if (iflush(ip) < 0 || pcache_write(ip, bn, boff, src + tot, towrite) < 0)
+                break;
+        }
         tot += towrite;
         off += towrite;
     }
     if (off > ip->size)
         ip->size = off;
+    if (pcache_dirty_count() >= NDIRTYMAX)
+        iflush(ip);
     return tot;
 }
 
+// 写回 inode 的全部脏页：每段连续脏页中尚无磁盘块的部分一次分配连续的块
+// （紧接在前一页的块之后，所需的间接表先于数据分配），数据写回后再在同一事务中提交块指针与大小
+#define FLUSH_MAXRUN NPCACHE
+
+int iflush(struct inode *ip)
+{
+    uint bnums[FLUSH_MAXRUN];
+    uint pg, n;
+
+    while ((n = pcache_dirty_run(ip, &pg, FLUSH_MAXRUN)) > 0)
+    {
+        begin_op();
+        for (uint i = 0; i < n;)
+        {
+            bnums[i] = bmap_peek(ip, pg + i);
+            if (bnums[i])
+            {
+                i++;
+                continue;
+            }
+            uint want = 1;
+            while (i + want < n && bmap_peek(ip, pg + i + want) == 0)
+                want++;
+            uint goal = 0;
+            if (i > 0)
+                goal = bnums[i - 1] + 1;
+            else if (pg > 0 && bmap_peek(ip, pg - 1))
+                goal = bmap_peek(ip, pg - 1) + 1;
+            // 先分配这段页需要的间接表，表位于数据块之前，数据块本身保持连续
+            uint tgoal = goal ? goal : sb.bmapstart + 1;
+            for (uint k = 0; k < want; k++)
+            {
+                uint idx;
+                if (pg + i + k >= NDIRECT && bmap_table(ip, pg + i + k, &idx, tgoal) == 0)
+                {
+                    end_op();
+                    return -1;
+                }
+            }
+            uint got;
+            uint b = balloc_run(goal, want, &got);
+            if (b == 0)
+            {
+                end_op();
+                return -1;
+            }
+            for (uint k = 0; k < got; k++)
+            {
+                if (bmap_set(ip, pg + i + k, b + k) < 0)
+                {
+                    end_op();
+                    return -1;
+                }
+                bnums[i + k] = b + k;
+            }
+            i += got;
+        }
+        // 先写数据，再提交引用这些块的元数据
+        pcache_writeback(ip, pg, n, bnums);
+        iupdate(ip);
+        end_op();
+    }
+    return 0;
+}
+
+int balloc_count(void)
+{
+    return g_balloc_calls;
+}
+
+// ------- directories -------
+// 目录块整块读入临时页后在内存中扫描，每块一次 readi，而不是每个目录项一次。
+static int g_dir_blocks_read = 0;
+
+static int dir_readblock(struct inode *dp, uint bn, void *page)
+{
+    g_dir_blocks_read++;
+    uint n = BSIZE;
+    if (bn * BSIZE + n > dp->size)
+        n = dp->size - bn * BSIZE;
+    memset(page, 0, BSIZE);
+    return readi(dp, page, bn * BSIZE, n) == (int)n ? 0 : -1;
+}
+
+static int namecmp(const char *s, const char *t)
+{
+    return strncmp(s, t, DIRSIZ);
+}
+
+static void dirent_set(struct dirent *de, const char *name, uint inum)
+{
+    de->inum = (ushort)inum;
+    strncpy(de->name, name, DIRSIZ);
+}
+
+// FNV-1a
+static uint dir_hash(const char *name)
+{
+    uint h = 2166136261u;
+    for (int i = 0; i < DIRSIZ && name[i]; i++)
+    {
+        h ^= (uchar)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int dir_indexed(struct inode *dp, void *page)
+{
+    return dp->size >= BSIZE && ((struct dirindex *)page)->magic == DIR_MAGIC;
+}
+
+// 在 n 个目录项中查找 name，返回下标，-1 = 不存在；freeidx 记录第一个空项
+static int dirent_find(struct dirent *de, int n, const char *name, int *freeidx)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (de[i].inum == 0)
+        {
+            if (freeidx && *freeidx < 0)
+                *freeidx = i;
+            continue;
+        }
+        if (namecmp(de[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// 在目录 dp 中查找 name，找到时返回 iget 的 inode 并在 poff 中给出目录项的字节偏移
+struct inode *dirlookup(struct inode *dp, const char *name, uint *poff)
+{
+    if (!dp || !name || dp->type != T_DIR || dp->size == 0)
+        return 0;
+    char *page = (char *)alloc_page();
+    if (page == 0)
+        return 0;
+
+    struct inode *ip = 0;
+    if (dir_readblock(dp, 0, page) < 0)
+        goto out;
+    if (!dir_indexed(dp, page))
+    {
+        int i = dirent_find((struct dirent *)page, dp->size / sizeof(struct dirent), name, 0);
+        if (i >= 0)
+        {
+            if (poff)
+                *poff = i * sizeof(struct dirent);
+            ip = iget(dp->dev, ((struct dirent *)page)[i].inum);
+        }
+        goto out;
+    }
+
+    uint bn = ((struct dirindex *)page)->bucket[dir_hash(name) % DIR_NBUCKET];
+    while (bn)
+    {
+        if (dir_readblock(dp, bn, page) < 0)
+            break;
+        struct dirbucket *b = (struct dirbucket *)page;
+        int i = dirent_find(b->de, b->count, name, 0);
+        if (i >= 0)
+        {
+            if (poff)
+                *poff = bn * BSIZE + 16 + i * sizeof(struct dirent);
+            ip = iget(dp->dev, b->de[i].inum);
+            break;
+        }
+        bn = b->next;
+    }
+out:
+    free_page(page);
+    return ip;
+}
+
+// 取得目录第 bn 块的缓冲区，块不存在时分配一个清零的块；须在事务中调用
+static struct buf *dir_getblock(struct inode *dp, uint bn)
+{
+    uint b = bmap_peek(dp, bn);
+    if (b)
+        return bread(dp->dev, b);
+    uint goal = bn > 0 ? bmap_peek(dp, bn - 1) + 1 : 0;
+    if ((b = balloc(goal)) == 0)
+        return 0;
+    if (bmap_set(dp, bn, b) < 0)
+    {
+        bfree(b);
+        return 0;
+    }
+    struct buf *bp = bread(dp->dev, b);
+    memset(bp->data, 0, BSIZE);
+    return bp;
+}
+
+// 修改目录 off 处的 n 字节（不跨块），超出 size 时扩展目录；须在事务中调用。
+// 目录块经日志写入，与同一名字空间操作的其他修改一起提交。
+// 内联目录超出内联容量时，原有内容移入新分配的第 0 块
+static int dir_write(struct inode *dp, const void *src, uint off, uint n)
+{
+    if (INODE_INLINE(dp) && off + n <= INLINE_MAX)
+    {
+        memmove((char *)dp->addrs + off, src, n);
+        if (off + n > dp->size)
+            dp->size = off + n;
+        iupdate(dp);
+        return 0;
+    }
+    struct buf *bp;
+    if (INODE_INLINE(dp))
+    {
+        uint b = balloc(0);
+        if (b == 0)
+            return -1;
+        bp = bread(dp->dev, b);
+        memset(bp->data, 0, BSIZE);
+        memmove(bp->data, dp->addrs, dp->size);
+        memset(dp->addrs, 0, sizeof(dp->addrs));
+        dp->addrs[0] = b;
+    }
+    else if ((bp = dir_getblock(dp, off / BSIZE)) == 0)
+    {
+        return -1;
+    }
+    memmove(bp->data + off % BSIZE, src, n);
+    log_write(bp);
+    brelse(bp);
+    if (off + n > dp->size)
+        dp->size = off + n;
+    iupdate(dp);
+    return 0;
+}
+
+// 向哈希目录的桶中插入一项，page 为调用者提供的临时页；须在事务中调用。
+// 先走完整条桶链查重，同时记下第一个可用位置（空项或块尾），之后才写入
+static int dir_bucket_insert(struct inode *dp, struct dirindex *idx, const char *name, uint inum, char *page)
+{
+    uint h = dir_hash(name) % DIR_NBUCKET;
+    uint bn = idx->bucket[h];
+    uint prev = 0;
+    uint slotbn = 0;
+    int slotidx = -1, append = 0;
+    struct dirent de;
+    dirent_set(&de, name, inum);
+
+    while (bn)
+    {
+        if (dir_readblock(dp, bn, page) < 0)
+            return -1;
+        struct dirbucket *b = (struct dirbucket *)page;
+        int freeidx = -1;
+        if (dirent_find(b->de, b->count, name, &freeidx) >= 0)
+            return -1;
+        if (slotbn == 0 && (freeidx >= 0 || b->count < DIRB_NENT))
+        {
+            slotbn = bn;
+            slotidx = freeidx >= 0 ? freeidx : (int)b->count;
+            append = freeidx < 0;
+        }
+        prev = bn;
+        bn = b->next;
+    }
+
+    if (slotbn)
+    {
+        if (append)
+        {
+            // 追加到已用项之后，并更新块头的 count
+            uint count = slotidx + 1;
+            if (dir_write(dp, &count, slotbn * BSIZE + 4, sizeof(count)) < 0)
+                return -1;
+        }
+        uint off = slotbn * BSIZE + 16 + slotidx * sizeof(struct dirent);
+        return dir_write(dp, &de, off, sizeof(de));
+    }
+
+    // 桶为空或链上各块都已满：在目录末尾追加一个新的桶块
+    uint nbn = (dp->size + BSIZE - 1) / BSIZE;
+    memset(page, 0, BSIZE);
+    struct dirbucket *b = (struct dirbucket *)page;
+    b->count = 1;
+    b->de[0] = de;
+    if (dir_write(dp, page, nbn * BSIZE, BSIZE) < 0)
+        return -1;
+    if (prev)
+    {
+        // 链到上一个块之后
+        uint next = nbn;
+        return dir_write(dp, &next, prev * BSIZE, sizeof(next));
+    }
+    idx->bucket[h] = nbn;
+    return dir_write(dp, &idx->bucket[h], (char *)&idx->bucket[h] - (char *)idx, sizeof(uint));
+}
+
+// 线性目录已满（DIR_LINEAR_MAX 项且没有空项）时转换为哈希格式；须在事务之外调用。
+// 一次转换写的桶块可能超过一个事务的预留，因此分阶段进行：每个桶块在自己的小事务中
+// 写到目录末尾之后（size 不变，目录仍按线性格式解释），最后一个事务把第 0 块改写为索引
+// 并更新 size。中途崩溃时目录仍是完整的线性目录，已写的桶块在下一次转换时被覆盖复用。
+static int dir_convert(struct inode *dp)
+{
+    if (dp->type != T_DIR || INODE_INLINE(dp))
+        return 0;
+    char *page = (char *)alloc_page();
+    struct dirindex *idx = (struct dirindex *)alloc_page();
+    int r = -1;
+    if (page == 0 || idx == 0 || dir_readblock(dp, 0, page) < 0)
+        goto out;
+    r = 0;
+    int n = dp->size / sizeof(struct dirent);
+    if (dir_indexed(dp, page) || n < DIR_LINEAR_MAX)
+        goto out;
+    struct dirent old[DIR_LINEAR_MAX];
+    memmove(old, page, sizeof(old));
+    for (int i = 0; i < DIR_LINEAR_MAX; i++)
+    {
+        if (old[i].inum == 0)
+            goto out;
+    }
+
+    memset(idx, 0, BSIZE);
+    idx->magic = DIR_MAGIC;
+    idx->nbuckets = DIR_NBUCKET;
+    uint nbn = 1;
+    for (uint h = 0; h < DIR_NBUCKET && r == 0; h++)
+    {
+        memset(page, 0, BSIZE);
+        struct dirbucket *b = (struct dirbucket *)page;
+        for (int i = 0; i < DIR_LINEAR_MAX; i++)
+        {
+            if (dir_hash(old[i].name) % DIR_NBUCKET == h)
+                b->de[b->count++] = old[i];
+        }
+        if (b->count == 0)
+            continue;
+        begin_op();
+        struct buf *bp = dir_getblock(dp, nbn);
+        if (bp == 0)
+        {
+            r = -1;
+        }
+        else
+        {
+            memmove(bp->data, page, BSIZE);
+            log_write(bp);
+            brelse(bp);
+            iupdate(dp);
+            idx->bucket[h] = nbn++;
+        }
+        end_op();
+    }
+    if (r < 0)
+        goto out;
+
+    begin_op();
+    struct buf *bp = dir_getblock(dp, 0);
+    memmove(bp->data, idx, BSIZE);
+    log_write(bp);
+    brelse(bp);
+    dp->size = nbn * BSIZE;
+    iupdate(dp);
+    end_op();
+
+out:
+    if (page)
+        free_page(page);
+    if (idx)
+        free_page(idx);
+    return r;
+}
+
+// 在目录 dp 中加入 name -> inum；名字已存在、或线性目录已满尚未转换时返回 -1。
+// 须在事务中调用。查重与找空位在同一次扫描中完成，哈希目录只访问名字所在的桶。
+static int dir_insert(struct inode *dp, const char *name, uint inum)
+{
+    if (!dp || !name || !name[0] || dp->type != T_DIR)
+        return -1;
+    char *page = (char *)alloc_page();
+    if (page == 0)
+        return -1;
+
+    int r = -1;
+    if (dp->size > 0 && dir_readblock(dp, 0, page) < 0)
+        goto out;
+    if (dp->size == 0 || !dir_indexed(dp, page))
+    {
+        int n = dp->size / sizeof(struct dirent);
+        int freeidx = -1;
+        if (dp->size > 0 && dirent_find((struct dirent *)page, n, name, &freeidx) >= 0)
+            goto out;
+        if (freeidx < 0 && n >= DIR_LINEAR_MAX)
+            goto out;
+        struct dirent de;
+        dirent_set(&de, name, inum);
+        uint off = (freeidx >= 0 ? freeidx : n) * sizeof(struct dirent);
+        r = dir_write(dp, &de, off, sizeof(de));
+        goto out;
+    }
+
+    struct dirindex *idx = (struct dirindex *)alloc_page();
+    if (idx == 0)
+        goto out;
+    memmove(idx, page, BSIZE);
+    r = dir_bucket_insert(dp, idx, name, inum, page);
+    free_page(idx);
+out:
+    free_page(page);
+    if (r == 0)
+        dcache_enter(dp->dev, dp->inum, name, inum);
+    return r;
+}
+
+// 在目录 dp 中加入 name -> inum；名字已存在时返回 -1。
+// 需要时先把线性目录转换为哈希格式，插入本身是一个事务。
+int dirlink(struct inode *dp, const char *name, uint inum)
+{
+    if (dir_convert(dp) < 0)
+        return -1;
+    begin_op();
+    int r = dir_insert(dp, name, inum);
+    end_op();
+    return r;
+}
+
+// 从目录 dp 中删除 name 并把其 inode 的链接数减一；名字不存在时返回 -1。
+// 目录项与链接数的修改在同一个事务中提交
+int dirunlink(struct inode *dp, const char *name)
+{
+    uint off;
+    begin_op();
+    struct inode *ip = dirlookup(dp, name, &off);
+    if (ip == 0)
+    {
+        end_op();
+        return -1;
+    }
+    struct dirent de;
+    memset(&de, 0, sizeof(de));
+    int r = dir_write(dp, &de, off, sizeof(de));
+    if (r == 0)
+    {
+        ip->nlink--;
+        iupdate(ip);
+    }
+    end_op();
+    if (r == 0)
+        dcache_enter(dp->dev, dp->inum, name, 0);
+    iput(ip);
+    return r;
+}
+
+// 取出路径中的下一个名字，返回其后的剩余路径；没有更多名字时返回 0
+// skipelem("a/bb/c", name) = "bb/c", name = "a"
+static const char *skipelem(const char *path, char *name)
+{
+    while (*path == '/')
+        path++;
+    if (*path == 0)
+        return 0;
+    const char *s = path;
+    while (*path != '/' && *path != 0)
+        path++;
+    int len = path - s;
+    if (len >= DIRSIZ)
+        memmove(name, s, DIRSIZ);
+    else
+    {
+        memmove(name, s, len);
+        name[len] = 0;
+    }
+    while (*path == '/')
+        path++;
+    return path;
+}
+
+// 只支持绝对路径；nameiparent 非零时返回父目录并把最后一个名字拷入 name
+static struct inode *namex(const char *path, int nameiparent, char *name)
+{
+    if (!path || path[0] != '/')
+        return 0;
+    struct inode *ip = iget(0, ROOTINO);
+    struct inode *next;
+
+    while ((path = skipelem(path, name)) != 0)
+    {
+        if (ip->type != T_DIR)
+        {
+            iput(ip);
+            return 0;
+        }
+        if (nameiparent && *path == '\0')
+        {
+            // Stop one level early.
+            return ip;
+        }
+        // 先查路径名缓存，命中（包括负项）时不读目录
+        uint inum;
+        if (dcache_lookup(ip->dev, ip->inum, name, &inum))
+        {
+            next = inum ? iget(ip->dev, inum) : 0;
+        }
+        else
+        {
+            next = dirlookup(ip, name, 0);
+            dcache_enter(ip->dev, ip->inum, name, next ? next->inum : 0);
+        }
+        if (next == 0)
+        {
+            iput(ip);
+            return 0;
+        }
+        iput(ip);
+        ip = next;
+    }
+    if (nameiparent)
+    {
+        iput(ip);
+        return 0;
+    }
+    return ip;
+}
+
+struct inode *namei(const char *path)
+{
+    char name[DIRSIZ];
+    return namex(path, 0, name);
+}
+
+struct inode *nameiparent(const char *path, char *name)
+{
+    return namex(path, 1, name);
+}
+
+// 在 path 处创建 type 类型的 inode 并链接到父目录；已存在时返回 0。
+// 分配 inode 与加入目录项在同一个事务中提交（需要时先转换父目录的格式）
+struct inode *create(const char *path, short type)
+{
+    char name[DIRSIZ + 1];
+    name[DIRSIZ] = 0;
+    struct inode *dp = nameiparent(path, name);
+    if (dp == 0)
+        return 0;
+    if (dir_convert(dp) < 0)
+    {
+        iput(dp);
+        return 0;
+    }
+
+    begin_op();
+    struct inode *ip = dirlookup(dp, name, 0);
+    if (ip)
+    {
+        // 名字已存在：不分配 inode
+        end_op();
+        iput(ip);
+        iput(dp);
+        return 0;
+    }
+    ip = ialloc_txn(dp->dev, type);
+    if (ip && dir_insert(dp, name, ip->inum) < 0)
+    {
+        // 目录写入失败：撤销分配（iput 在事务之外回收）
+        ip->nlink = 0;
+        iupdate(ip);
+        end_op();
+        iput(ip);
+        iput(dp);
+        return 0;
+    }
+    end_op();
+    iput(dp);
+    return ip;
+}
+
+int dir_blocks_read(void)
+{
+    return g_dir_blocks_read;
+}
+
 void fs_init(void)
 {
+    // 页缓存从物理页分配器取页
+    pmem_init();
     binit();
+    pcache_init();
     iinit();
+    dcache_init();
+    log_init();
+    imap_init();
     // create root inode if necessary
-    struct inode *r = &inodes[ROOTINO];
-    if (!r->valid)
+    if (!(imap[ROOTINO / 8] & (1 << (ROOTINO % 8))))
     {
-        r->valid = 1;
-        r->type = 1; // dir
+        imap[ROOTINO / 8] |= 1 << (ROOTINO % 8);
+        struct inode *r = iget(0, ROOTINO);
+        begin_op();
+        r->type = T_DIR;
         r->nlink = 1;
         r->size = 0;
-        r->ref = 1;
+        memset(r->addrs, 0, sizeof(r->addrs));
+        iupdate(r);
+        end_op();
+        iput(r);
     }
+    // 后台提交到期的事务组并安装检查点
+    log_start_checkpointer();
 }
 
 // ---- debug helpers ----
@@ -292,9 +1386,9 @@ void read_superblock(struct superblock *out)
 int count_free_inodes(void)
 {
     int freec = 0;
-    for (int i = 0; i < (int)(sizeof(inodes) / sizeof(inodes[0])); i++)
+    for (uint inum = 1; inum < sb.ninodes; inum++)
     {
-        if (!inodes[i].valid)
+        if (!(imap[inum / 8] & (1 << (inum % 8))))
             freec++;
     }
     return freec;
@@ -302,36 +1396,35 @@ int count_free_inodes(void)
 
 int count_free_blocks(void)
 {
-    // scan blocks after bmapstart to end; consider a block free if all zero
+    // scan blocks after bmapstart to end
     int freeb = 0;
     for (uint b = sb.bmapstart + 1; b < sb.size; b++)
     {
-        struct buf *bb = bread(0, b);
-        int allzero = 1;
-        for (int i = 0; i < BSIZE; i++)
-        {
-            if (bb->data[i])
-            {
-                allzero = 0;
-                break;
-            }
-        }
-        if (allzero)
+        if (block_is_free(b))
             freeb++;
-        brelse(bb);
     }
     return freeb;
 }
 
-// ---- inode table inspection helpers ----
+// ---- inode cache inspection helpers ----
 int fs_inode_count(void)
 {
-    return (int)(sizeof(inodes) / sizeof(inodes[0]));
+    return NINODE;
 }
 
 struct inode *fs_inode_at(int idx)
 {
-    if (idx < 0 || idx >= (int)(sizeof(inodes) / sizeof(inodes[0])))
+    if (idx < 0 || idx >= NINODE)
         return 0;
-    return &inodes[idx];
+    return &icache.inode[idx];
+}
+
+int icache_hits(void)
+{
+    return g_icache_hits;
+}
+
+int icache_misses(void)
+{
+    return g_icache_misses;
 }
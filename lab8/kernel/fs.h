@@ -4,12 +4,19 @@
 
 #include "types.h"
 #include "spinlock.h"
+#include "virtio.h"
 
 #define BSIZE 4096   // block size
-#define NBLOCKS 1024 // total blocks in simulated disk (bio.c)
-#define NDIRECT 12
+#define FSMAGIC 0x10203040
+#define NINODES 200  // inodes in the on-disk inode table
+#define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NDINDIRECT (NINDIRECT * NINDIRECT)
+#define NTINDIRECT ((uint64)NDINDIRECT * NINDIRECT)
+#define MAXFILE (NDIRECT + NINDIRECT + NDINDIRECT + NTINDIRECT)
+// 不超过 INLINE_MAX 字节的文件直接存放在 inode 的 addrs[] 中，没有数据块
+#define INLINE_MAX ((NDIRECT + 3) * sizeof(uint))
+#define INODE_INLINE(ip) ((ip)->size <= INLINE_MAX)
 
 // on-disk inode
 struct dinode
@@ -19,7 +26,7 @@ struct dinode
     short minor;
     short nlink;
     uint size;
-    uint addrs[NDIRECT + 1]; // last one is indirect
+    uint addrs[NDIRECT + 3]; // then single, double and triple indirect
 };
 
 // superblock
@@ -48,9 +55,21 @@ struct inode
     short minor;
     short nlink;
     uint size;
-    uint addrs[NDIRECT + 1];
+    uint addrs[NDIRECT + 3];
+    uint ind_base;  // first logical block mapped by ind_blk
+    uint ind_blk;   // last-used bottom-level indirect table, 0 = none
+    void *pc_root;  // page cache radix tree root (pcache.c)
+    int pc_height;  // page cache radix tree height, 0 = empty
+    int ndirty;     // dirty pages in the page cache, no blocks allocated yet
+    struct inode *hnext;    // inode cache hash chain
+    struct inode *lru_prev; // inode cache LRU list (unreferenced entries)
+    struct inode *lru_next;
 };
 
+// block I/O operations for bio_submit
+#define BIO_READ 0
+#define BIO_WRITE 1
+
 // buffer structure
 struct buf
 {
@@ -59,10 +78,24 @@ struct buf
     uint dev;
     uint blockno;
     int refcnt;
+    uint lastuse; // refcnt 降为 0 时的时间戳，bread 按 LRU 回收
     struct spinlock lock;
-    uchar data[BSIZE];
+    uchar *data; // BSIZE bytes: bio.c's own storage, or a page-cache page
+
+    // asynchronous I/O state (bio_submit)
+    int op;                       // BIO_READ / BIO_WRITE
+    volatile int iodone;          // set when the device has finished this block
+    void (*end_io)(struct buf *); // completion callback, may be 0
+    struct buf *qnext;            // scheduler queue / merged request chain
+    uint64 qtime;                 // time queued, for scheduler deadlines and latency
+    struct vreq req;              // device request, used when this buf heads a merged run
 };
 
+// inode types
+#define T_DIR 1    // directory
+#define T_FILE 2   // regular file
+#define T_DEVICE 3 // device
+
 // on-disk dirent
 #define DIRSIZ 14
 struct dirent
@@ -71,11 +104,43 @@ struct dirent
     char name[DIRSIZ];
 };
 
+// 目录格式：小目录是 dirent 的线性数组；超过 DIR_LINEAR_MAX 项后转为哈希索引格式，
+// 第 0 块是 dirindex，按名字哈希映射到桶；每个桶是若干个 dirbucket 块组成的链。
+#define DIR_LINEAR_MAX 32
+#define DIR_MAGIC 0x58444944 // "DIDX"，低 16 位大于任何 inum，与线性格式可区分
+#define DIR_NBUCKET 64
+#define DIRB_NENT ((BSIZE - 16) / sizeof(struct dirent))
+
+struct dirindex
+{
+    uint magic;
+    uint nbuckets;
+    uint bucket[DIR_NBUCKET]; // 桶首块的目录内逻辑块号，0 = 空桶
+};
+
+struct dirbucket
+{
+    uint next;  // 溢出块的目录内逻辑块号，0 = 无
+    uint count; // 已使用的项数（含已删除后复用的空项）
+    uint pad[2];
+    struct dirent de[DIRB_NENT];
+};
+
 void fs_init(void);
 void binit(void);
 struct buf *bread(uint dev, uint blockno);
 void bwrite(struct buf *b);
 void brelse(struct buf *b);
+void bpin(struct buf *b);
+void bunpin(struct buf *b);
+void disk_read(uint blockno, void *dst);
+void disk_write(uint blockno, void *src);
+void bio_initbuf(struct buf *b, uint blockno, void *data);
+void bio_submit(struct buf *b, int op, void (*end_io)(struct buf *));
+void bio_flush(void);
+void bio_wait(struct buf *b);
+int bio_request_count(void);
+int bio_merge_count(void);
 
 // debug helpers
 void read_superblock(struct superblock *out);
@@ -95,6 +160,41 @@ void iunlock(struct inode *ip);
 void iput(struct inode *ip);
 int readi(struct inode *ip, char *dst, uint off, uint n);
 int writei(struct inode *ip, char *src, uint off, uint n);
+int iflush(struct inode *ip);
+int balloc_count(void);
+void bfree_commit(void);
+int indcache_hits(void);
+uint bmap_peek(struct inode *ip, uint bn);
+struct inode *dirlookup(struct inode *dp, const char *name, uint *poff);
+int dirlink(struct inode *dp, const char *name, uint inum);
+int dirunlink(struct inode *dp, const char *name);
+struct inode *namei(const char *path);
+struct inode *nameiparent(const char *path, char *name);
+struct inode *create(const char *path, short type);
+int dir_blocks_read(void);
+
+// pathname lookup cache (dcache.c)
+void dcache_init(void);
+int dcache_lookup(uint dev, uint dinum, const char *name, uint *pinum);
+void dcache_enter(uint dev, uint dinum, const char *name, uint inum);
+void dcache_purge(uint dev, uint inum);
+int dcache_hits(void);
+int dcache_misses(void);
+
+// page cache (pcache.c)
+void pcache_init(void);
+uint64 pcache_get(struct inode *ip, uint pgoff);
+int pcache_read(struct inode *ip, uint pgoff, uint boff, char *dst, uint n);
+int pcache_write(struct inode *ip, uint pgoff, uint boff, char *src, uint n);
+uint pcache_dirty_run(struct inode *ip, uint *pgoff, uint max);
+void pcache_writeback(struct inode *ip, uint pgoff, uint n, uint *bnums);
+int pcache_dirty_count(void);
+void pcache_drop(struct inode *ip);
+void pcache_readahead(struct inode *ip, uint pgoff, uint npages);
+int pcache_ra_hits(void);
+int pcache_ra_wasted(void);
+int pcache_hits(void);
+int pcache_misses(void);
 
 // file layer
 void fileinit(void);
@@ -102,9 +202,23 @@ struct file *filealloc(void);
 
 // log
 void log_init(void);
+void begin_op(void);
+void end_op(void);
+void log_write(struct buf *b);
+void log_force(void);
+void log_checkpoint(void);
+void log_start_checkpointer(void);
+int log_holds(uint blockno);
+int log_commit_count(void);
+int log_op_count(void);
+int log_block_count(void);
+int log_ckpt_installs(void);
+int log_ckpt_absorbed(void);
 
 // inode table inspection helpers (for tests)
 int fs_inode_count(void);
 struct inode *fs_inode_at(int idx);
+int icache_hits(void);
+int icache_misses(void);
 
 #endif
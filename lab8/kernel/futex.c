@@ -0,0 +1,135 @@
+// kernel/futex.c
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "vm.h"
+
+// futex：用户态锁在无竞争时只用原子指令，有竞争时才经系统调用在内核中等待。
+// 等待者以 uaddr 对应的物理地址为键挂在哈希桶上，因此映射了同一物理页的不同进程
+// （共享内存段、共享的文件映射）在各自的虚拟地址上等待同一个字也能相互唤醒。
+// 等待项位于等待进程的内核栈上；检查 *uaddr 与入队在同一个桶锁下完成，
+// 唤醒方修改 *uaddr 后再取桶锁唤醒，因此不会丢失唤醒。
+#define FHASH 31
+
+struct futex_waiter
+{
+    uint64 pa;
+    int woken;
+    struct futex_waiter *next;
+};
+
+static struct
+{
+    struct spinlock lock;
+    struct futex_waiter *head;
+} fbucket[FHASH];
+
+static int g_futex_waits = 0;
+
+void futexinit(void)
+{
+    for (int i = 0; i < FHASH; i++)
+    {
+        initlock(&fbucket[i].lock, "futex");
+        fbucket[i].head = 0;
+    }
+}
+
+// uaddr 对应的物理地址；无法映射或未按 4 字节对齐时返回 0。
+// 当前进程的页尚未映射（mmap 区域还没有缺页过）或映射为只读时，先按写缺页处理：
+// 私有文件映射在此复制出私有页，之后进程写这个字不会再换页，等待与唤醒用的是同一个键。
+// 不可写的映射退回读缺页，直接以页缓存的物理页为键
+static uint64 futex_pa(pagetable_t pt, uint64 uaddr)
+{
+    if (uaddr % sizeof(int) != 0)
+        return 0;
+    struct proc *p = myproc();
+    if (p && pt == p->pagetable)
+    {
+        pte_t *pte = walk_lookup(pt, PGROUNDDOWN(uaddr));
+        if (pte == 0 || !(*pte & PTE_V) || !(*pte & PTE_W))
+        {
+            if (mmap_fault(p, uaddr, 1) < 0)
+                mmap_fault(p, uaddr, 0);
+        }
+    }
+    uint64 pa = walkaddr(pt, PGROUNDDOWN(uaddr));
+    return pa ? pa + (uaddr - PGROUNDDOWN(uaddr)) : 0;
+}
+
+static int fhash(uint64 pa)
+{
+    return (pa >> 2) % FHASH;
+}
+
+// *uaddr 仍等于 val 时睡眠直到被唤醒，返回 0；值已改变、地址无效或被 kill 时返回 -1
+int futex_wait(pagetable_t pt, uint64 uaddr, int val)
+{
+    uint64 pa = futex_pa(pt, uaddr);
+    if (pa == 0)
+        return -1;
+    struct proc *p = myproc();
+    int h = fhash(pa);
+
+    acquire(&fbucket[h].lock);
+    if (*(volatile int *)pa != val)
+    {
+        release(&fbucket[h].lock);
+        return -1;
+    }
+    struct futex_waiter w;
+    w.pa = pa;
+    w.woken = 0;
+    w.next = fbucket[h].head;
+    fbucket[h].head = &w;
+    g_futex_waits++;
+    while (!w.woken && !p->killed)
+        sleep(&w, &fbucket[h].lock);
+    if (!w.woken)
+    {
+        // 被 kill：自行出队
+        struct futex_waiter **pp = &fbucket[h].head;
+        while (*pp != &w)
+            pp = &(*pp)->next;
+        *pp = w.next;
+    }
+    release(&fbucket[h].lock);
+    return w.woken ? 0 : -1;
+}
+
+// 唤醒至多 n 个等待在 uaddr 上的进程，返回唤醒的个数；地址无效时返回 -1
+int futex_wake(pagetable_t pt, uint64 uaddr, int n)
+{
+    uint64 pa = futex_pa(pt, uaddr);
+    if (pa == 0)
+        return -1;
+    int h = fhash(pa);
+    int woken = 0;
+
+    acquire(&fbucket[h].lock);
+    struct futex_waiter **pp = &fbucket[h].head;
+    while (*pp && woken < n)
+    {
+        struct futex_waiter *w = *pp;
+        if (w->pa != pa)
+        {
+            pp = &w->next;
+            continue;
+        }
+        *pp = w->next;
+        w->woken = 1;
+        wakeup(w);
+        woken++;
+    }
+    release(&fbucket[h].lock);
+    return woken;
+}
+
+// 进入过内核等待的次数
+int futex_wait_count(void)
+{
+    return g_futex_waits;
+}
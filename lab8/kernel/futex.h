@@ -0,0 +1,9 @@
+// kernel/futex.h
+#ifndef FUTEX_H
+#define FUTEX_H
+
+// futex 操作
+#define FUTEX_WAIT 0 // *uaddr == val 时睡眠，直到被 FUTEX_WAKE 唤醒
+#define FUTEX_WAKE 1 // 唤醒至多 val 个等待在 uaddr 上的进程
+
+#endif
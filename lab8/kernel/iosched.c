@@ -0,0 +1,185 @@
+// kernel/iosched.c
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "iosched.h"
+#include "printf.h"
+
+// 块层 I/O 调度。bio_submit 的 buf 按到达顺序挂在 queue 上（经 qnext 链接），
+// bio_flush 反复调用 iosched_dispatch：由当前策略选出请求头，
+// 再把队列中与之块号相邻、方向相同的 buf 摘下接在前后，合并成一个设备请求。
+// 所有函数由 bio.c 在持有 bio_lock 时调用。
+//
+// 策略：
+//   noop     - 按到达顺序下发，只做相邻块合并
+//   deadline - 平时按 C-LOOK 顺序，队首请求等待超过期限时优先下发（读期限短于写）
+//   clook    - 单向电梯：下发磁头位置之后块号最小的请求，到尽头后回到最小块号
+
+#ifndef IOSCHED_DEFAULT
+#define IOSCHED_DEFAULT "deadline"
+#endif
+
+// deadline 期限（cycles，qemu virt 时钟 10MHz）
+#define READ_EXPIRE 500000
+#define WRITE_EXPIRE 2500000
+
+static struct buf *queue; // 按到达顺序
+static uint last_pos;     // 上一个下发请求的末尾块号（磁头位置）
+static struct iosched_stats stats;
+
+static struct buf *noop_pick(void)
+{
+    return queue;
+}
+
+static struct buf *clook_pick(void)
+{
+    struct buf *ahead = 0, *lowest = 0;
+    for (struct buf *b = queue; b; b = b->qnext)
+    {
+        if (b->blockno >= last_pos && (ahead == 0 || b->blockno < ahead->blockno))
+            ahead = b;
+        if (lowest == 0 || b->blockno < lowest->blockno)
+            lowest = b;
+    }
+    return ahead ? ahead : lowest;
+}
+
+static struct buf *deadline_pick(void)
+{
+    // 队首是最早到达的请求，只需检查它是否超时
+    if (queue)
+    {
+        uint64 expire = queue->op == BIO_READ ? READ_EXPIRE : WRITE_EXPIRE;
+        if (get_time() - queue->qtime > expire)
+        {
+            stats.expired++;
+            return queue;
+        }
+    }
+    return clook_pick();
+}
+
+static struct iosched_ops policies[] = {
+    {"noop", noop_pick},
+    {"deadline", deadline_pick},
+    {"clook", clook_pick},
+};
+#define NPOLICY ((int)(sizeof(policies) / sizeof(policies[0])))
+
+static struct iosched_ops *cur;
+
+void iosched_init(void)
+{
+    queue = 0;
+    last_pos = 0;
+    memset(&stats, 0, sizeof(stats));
+    if (cur == 0 && iosched_select(IOSCHED_DEFAULT) < 0)
+        cur = &policies[0];
+}
+
+// 按名字切换调度策略，成功返回 0；队列中已有的请求不受影响
+int iosched_select(const char *name)
+{
+    for (int i = 0; i < NPOLICY; i++)
+    {
+        if (strncmp(policies[i].name, name, 16) == 0)
+        {
+            cur = &policies[i];
+            return 0;
+        }
+    }
+    printf("iosched: unknown policy '%s'\n", name);
+    return -1;
+}
+
+const char *iosched_name(void)
+{
+    return cur ? cur->name : "none";
+}
+
+// 入队，返回当前队列深度
+int iosched_add(struct buf *b)
+{
+    struct buf **pp = &queue;
+    while (*pp)
+        pp = &(*pp)->qnext;
+    b->qnext = 0;
+    b->qtime = get_time();
+    *pp = b;
+    stats.queued++;
+    stats.depth++;
+    if (stats.depth > stats.max_depth)
+        stats.max_depth = stats.depth;
+    return stats.depth;
+}
+
+static void queue_remove(struct buf *b)
+{
+    struct buf **pp = &queue;
+    while (*pp != b)
+        pp = &(*pp)->qnext;
+    *pp = b->qnext;
+    b->qnext = 0;
+    stats.depth--;
+}
+
+// 取出下一个要下发的请求：返回请求头，qnext 链上是合并进来的后续块（块号连续）
+struct buf *iosched_dispatch(void)
+{
+    struct buf *head = cur->pick();
+    if (head == 0)
+        return 0;
+    queue_remove(head);
+
+    // 向后、向前合并：不断寻找紧接在末尾之后或开头之前的同向块
+    struct buf *last = head;
+    int nseg = 1;
+    while (nseg < VREQ_MAXSEG)
+    {
+        struct buf *b, *front = 0;
+        for (b = queue; b; b = b->qnext)
+        {
+            if (b->op != head->op)
+                continue;
+            if (b->blockno == last->blockno + 1)
+                break;
+            if (b->blockno + 1 == head->blockno)
+                front = b;
+        }
+        if (b)
+        {
+            queue_remove(b);
+            last->qnext = b;
+            last = b;
+        }
+        else if (front)
+        {
+            queue_remove(front);
+            front->qnext = head;
+            head = front;
+        }
+        else
+        {
+            break;
+        }
+        nseg++;
+        stats.merges++;
+    }
+    last_pos = last->blockno + 1;
+    stats.dispatched++;
+    return head;
+}
+
+// 一个块的 I/O 完成，记录延迟
+void iosched_complete(struct buf *b)
+{
+    stats.completed++;
+    stats.total_lat += get_time() - b->qtime;
+}
+
+void iosched_get_stats(struct iosched_stats *st)
+{
+    *st = stats;
+}
@@ -0,0 +1,38 @@
+// kernel/iosched.h
+#ifndef IOSCHED_H
+#define IOSCHED_H
+
+#include "types.h"
+
+struct buf;
+
+// 块层 I/O 调度策略：决定蓄积队列中的请求以什么顺序下发到设备
+struct iosched_ops
+{
+    char *name;
+    // 从队列中选出下一个要下发的 buf（不摘除）；队列为空返回 0
+    struct buf *(*pick)(void);
+};
+
+// 调度队列统计
+struct iosched_stats
+{
+    int queued;       // 进入队列的块数
+    int dispatched;   // 下发到设备的请求数（合并后）
+    int merges;       // 合并进前一个请求的块数
+    int depth;        // 当前队列深度
+    int max_depth;    // 观测到的最大队列深度
+    int expired;      // deadline：因超时被优先下发的请求数
+    int completed;    // 已完成的块数
+    uint64 total_lat; // 已完成块的总延迟（从入队到完成，cycles）
+};
+
+void iosched_init(void);
+int iosched_select(const char *name);
+const char *iosched_name(void);
+int iosched_add(struct buf *b);
+struct buf *iosched_dispatch(void);
+void iosched_complete(struct buf *b);
+void iosched_get_stats(struct iosched_stats *st);
+
+#endif
@@ -21,9 +21,21 @@ struct
     uint64 free_pages;      // 空闲页面数
 } kmem;
 
+// 物理页引用计数：同一物理页被多个页表映射（shm、fork）时每个映射各持有一个引用，
+// free_page 只在最后一个引用释放时才真正回收页面
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+static uint16 page_ref[(PHYSTOP - KERNBASE) / PGSIZE];
+
+static int pmem_inited = 0;
+
 // 初始化物理内存管理器
+// 多个测试和 fs_init 都会调用；只有第一次真正建立空闲链表，
+// 否则已分配的页会被再次加入空闲链表
 void pmem_init(void)
 {
+    if (pmem_inited)
+        return;
+    pmem_inited = 1;
     // initlock(&kmem.lock, "kmem");
 
     // 初始化统计信息
@@ -35,6 +47,7 @@ void pmem_init(void)
     char *p = (char *)PGROUNDUP((uint64)end);
     for (; p + PGSIZE <= (char *)PHYSTOP; p += PGSIZE)
     {
+        page_ref[PA2REF(p)] = 0;
         free_page(p);
         kmem.total_pages++;
     }
@@ -60,6 +73,7 @@ void *alloc_page(void)
 
     if (r)
     {
+        page_ref[PA2REF(r)] = 1;
         // 填充调试模式值，帮助检测未初始化内存
         memset((char *)r, 0xAA, PGSIZE);
     }
@@ -129,6 +143,14 @@ void free_page(void *pa)
     if ((char *)pa < end || (uint64)pa >= PHYSTOP)
         panic("free_page: out of range");
 
+    // 仍有其他映射引用该页，只减少引用计数
+    if (page_ref[PA2REF(pa)] > 1)
+    {
+        page_ref[PA2REF(pa)]--;
+        return;
+    }
+    page_ref[PA2REF(pa)] = 0;
+
     // 安全检查：清空页面内容，防止信息泄漏
     memset(pa, 0, PGSIZE);
 
@@ -141,3 +163,19 @@ void free_page(void *pa)
     kmem.free_pages++;
     // release(&kmem.lock);
 }
+
+// 为共享映射增加一个物理页引用；不属于分配区的页面（内核镜像、设备）忽略
+void page_ref_inc(void *pa)
+{
+    if ((char *)pa < end || (uint64)pa >= PHYSTOP)
+        return;
+    page_ref[PA2REF(pa)]++;
+}
+
+// 查询物理页当前引用计数（调试/测试用）
+int page_ref_count(void *pa)
+{
+    if ((char *)pa < end || (uint64)pa >= PHYSTOP)
+        return 0;
+    return page_ref[PA2REF(pa)];
+}
@@ -1,8 +1,12 @@
 #include "types.h"
+#include "param.h"
+#include "riscv.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "printf.h"
 #include "string.h"
 #include "defs.h" // for uart_putc prototype
+#include "fs.h"
 #include "log.h"
 #include <stdarg.h>
 
@@ -217,21 +221,599 @@ int klog_read(char *dst, int n)
     release(&log_buf.lock);
     return copied;
 }
-// kernel/log.c
-#include "types.h"
-#include "defs.h"
-#include "fs.h"
+// ---- 文件系统预写日志（write-ahead log） ----
+//
+// 元数据块的修改不直接写回原位置，而是在一个事务中 log_write 登记。
+// 日志区是一个循环缓冲：提交只把块追加写到 head 处的槽位，再写日志头（提交点）后返回；
+// 安装到原位置（检查点）由后台 checkpointer 线程延后进行，并推进 tail 释放槽位。
+// 同一块被多次提交时，较早的槽位被标记为已取代，检查点只安装最新的版本（吸收）。
+// 崩溃后 log_init 按槽位顺序重放 [tail, tail+n) 中已提交但未安装的块。
+//
+// 日志头记录最近一次提交所占槽位的 CRC32C，提交时数据块与日志头一起下发、
+// 一起等待，不再需要“先写数据、再写日志头”的屏障。恢复时校验该 CRC，
+// 不匹配说明最后一次提交未写完整，直接丢弃；日志头本身也带校验和。
+//
+// 组提交：end_op 时若没有进行中的操作，只有在日志装不下下一个操作的预留、
+// 或已累积 LOGGROUP 个操作时才真正提交，多个小事务合并成一次日志写。
+// 为限制延迟，组内第一个块登记后超过 LOG_COMMIT_DELAY 仍未提交时，下一次 end_op
+// 立即提交；没有新操作到来时由 checkpointer 到期后强制提交。
+// 每个操作在 begin_op 时预留 MAXOPBLOCKS 个日志块；提交在 fslog.lock 之外进行，
+// 提交期间新的 begin_op 睡眠等待，其余进程仍可运行。
+//
+// 磁盘上日志区布局：[ 日志头 | 槽位 0 .. LOGBLOCKS-1 ]
+
+struct logheader
+{
+    int tail;             // 最早的未安装槽位
+    int n;                // 从 tail 起已提交、未安装的槽位数
+    int block[LOGBLOCKS]; // 槽位 -> 原位置块号
+    int txn_start;        // 最近一次提交的第一个槽位
+    int txn_n;            // 最近一次提交的槽位数（位于 [tail, tail+n) 末尾）
+    uint txn_crc;         // 这些槽位内容的 CRC32C
+    uint hcrc;            // 以上字段的 CRC32C
+};
+
+struct log
+{
+    struct spinlock lock;
+    int start;        // 日志头所在块
+    int size;         // 日志区块数（含日志头）
+    int outstanding;  // 正在执行的文件系统操作数
+    int committing;   // 正在提交
+    int grouped;      // 当前组内已结束的操作数
+    int ckpt_running; // 正在安装检查点
+    int head_busy;    // 日志头正在被写（提交与检查点串行写日志头）
+    int checkpointer; // 后台 checkpointer 线程的 pid，0 表示未启动
+    uint64 group_start; // 当前组第一个块登记的时间
+
+    // 已提交部分：与磁盘上的日志头一致
+    struct logheader dh;
+    struct buf *cbufs[LOGBLOCKS]; // 已提交槽位对应的缓存块（钉住直到安装或被取代）
+    char stale[LOGBLOCKS];        // 槽位已被后续提交取代，检查点跳过（仅内存）
+
+    // 当前打开的事务组
+    int n;
+    int block[LOGBLOCKS];
+    struct buf *bufs[LOGBLOCKS];
+};
+static struct log fslog;
+
+// 已提交槽位达到该数目时唤醒 checkpointer
+#define CKPT_THRESH (LOGBLOCKS / 2)
+
+static int g_log_commits = 0;   // 提交次数
+static int g_log_ops = 0;       // 结束的操作数
+static int g_log_blocks = 0;    // 写入日志区的块数
+static int g_ckpt_installs = 0; // 检查点安装到原位置的块数
+static int g_ckpt_absorbed = 0; // 被后续提交取代、无需安装的槽位数
 
-// Minimal stub logging to satisfy dependencies from task.md.
-static int log_inited = 0;
+// 日志区 I/O 用的临时 buf 与检查点中转缓冲区
+static struct buf logio[LOGBLOCKS];
+static struct buf headio;
+static uchar headpage[BSIZE];
+static struct buf ckptio[2][VREQ_MAXSEG];
+static uchar ckpt_stage[VREQ_MAXSEG][BSIZE];
 
+// CRC32C（Castagnoli，反射多项式 0x82F63B78），查表法
+static uint crc_table[256];
+
+static uint crc32c(uint crc, const void *buf, int len)
+{
+    const uchar *p = (const uchar *)buf;
+    if (crc_table[1] == 0)
+    {
+        for (uint i = 0; i < 256; i++)
+        {
+            uint c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+            crc_table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len-- > 0)
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint head_crc(struct logheader *lh)
+{
+    return crc32c(0, lh, (int)((char *)&lh->hcrc - (char *)lh));
+}
+
+// 独占日志头的写入，调用者持有 fslog.lock
+static void head_lock(void)
+{
+    while (fslog.head_busy)
+        sleep(&fslog.head_busy, &fslog.lock);
+    fslog.head_busy = 1;
+}
+
+static void head_unlock(void)
+{
+    fslog.head_busy = 0;
+    wakeup(&fslog.head_busy);
+}
+
+// 填好校验和并把 lh 放入日志头缓冲区，提交写请求但不等待；调用者持有 head_busy
+static void submit_head(struct logheader *lh)
+{
+    lh->hcrc = head_crc(lh);
+    memset(headpage, 0, BSIZE);
+    memmove(headpage, lh, sizeof(*lh));
+    bio_initbuf(&headio, fslog.start, headpage);
+    bio_submit(&headio, BIO_WRITE, 0);
+}
+
+// 同步写日志头
+static void write_head(struct logheader *lh)
+{
+    submit_head(lh);
+    bio_wait(&headio);
+}
+
+// 安装 lh 中从 tail 开始的 k 个槽位：读日志槽位再写回原位置，
+// 每批最多 VREQ_MAXSEG 块，读与写各自一次下发，由块层合并与调度。
+// 返回安装的块数；已被取代的槽位跳过。
+static int install_slots(struct logheader *lh, int k)
+{
+    int installed = 0;
+    int i = 0;
+    while (i < k)
+    {
+        int m = 0;
+        int slots[VREQ_MAXSEG];
+        for (; i < k && m < VREQ_MAXSEG; i++)
+        {
+            int slot = (lh->tail + i) % LOGBLOCKS;
+            if (fslog.stale[slot])
+                continue;
+            slots[m] = slot;
+            bio_initbuf(&ckptio[0][m], fslog.start + 1 + slot, ckpt_stage[m]);
+            bio_submit(&ckptio[0][m], BIO_READ, 0);
+            m++;
+        }
+        bio_flush();
+        for (int j = 0; j < m; j++)
+        {
+            bio_wait(&ckptio[0][j]);
+            bio_initbuf(&ckptio[1][j], lh->block[slots[j]], ckpt_stage[j]);
+            bio_submit(&ckptio[1][j], BIO_WRITE, 0);
+        }
+        bio_flush();
+        for (int j = 0; j < m; j++)
+            bio_wait(&ckptio[1][j]);
+        installed += m;
+    }
+    return installed;
+}
+
+// 校验最近一次提交的槽位内容是否与日志头中的 CRC 一致
+static int txn_intact(struct logheader *lh)
+{
+    uint crc = 0;
+    for (int i = 0; i < lh->txn_n; i++)
+    {
+        disk_read(fslog.start + 1 + (lh->txn_start + i) % LOGBLOCKS, ckpt_stage[0]);
+        crc = crc32c(crc, ckpt_stage[0], BSIZE);
+    }
+    return crc == lh->txn_crc;
+}
+
+static void recover_from_log(void)
+{
+    disk_read(fslog.start, headpage);
+    memmove(&fslog.dh, headpage, sizeof(fslog.dh));
+    if (head_crc(&fslog.dh) != fslog.dh.hcrc ||
+        fslog.dh.n < 0 || fslog.dh.n > LOGBLOCKS || fslog.dh.tail < 0 || fslog.dh.tail >= LOGBLOCKS ||
+        fslog.dh.txn_n < 0 || fslog.dh.txn_n > fslog.dh.n)
+    {
+        // 未初始化或损坏的日志头
+        fslog.dh.n = 0;
+        fslog.dh.tail = 0;
+    }
+    else if (fslog.dh.txn_n > 0 && !txn_intact(&fslog.dh))
+    {
+        // 最后一次提交的数据没有完整落盘：丢弃它，之前的提交不受影响
+        klog(LOG_LEVEL_WARN, "log: discarding torn commit of %d blocks", fslog.dh.txn_n);
+        fslog.dh.n -= fslog.dh.txn_n;
+    }
+    if (fslog.dh.n > 0)
+    {
+        klog(LOG_LEVEL_INFO, "log: recovering %d blocks", fslog.dh.n);
+        install_slots(&fslog.dh, fslog.dh.n);
+    }
+    memset(&fslog.dh, 0, sizeof(fslog.dh));
+    write_head(&fslog.dh);
+}
+
+// 挂载时调用：重放已提交的事务并清空日志
 void log_init(void)
 {
-    if (log_inited)
+    struct superblock sb;
+
+    if (sizeof(struct logheader) >= BSIZE)
+        panic("log_init: too big logheader");
+
+    read_superblock(&sb);
+    initlock(&fslog.lock, "log");
+    fslog.start = sb.logstart;
+    fslog.size = sb.nlog;
+    fslog.outstanding = 0;
+    fslog.committing = 0;
+    fslog.grouped = 0;
+    fslog.ckpt_running = 0;
+    fslog.head_busy = 0;
+    fslog.n = 0;
+    for (int i = 0; i < LOGBLOCKS; i++)
+    {
+        fslog.bufs[i] = 0;
+        fslog.cbufs[i] = 0;
+        fslog.stale[i] = 0;
+    }
+    g_log_commits = 0;
+    g_log_ops = 0;
+    g_log_blocks = 0;
+    g_ckpt_installs = 0;
+    g_ckpt_absorbed = 0;
+    recover_from_log();
+}
+
+// 提交打开的事务组：把登记的块追加到循环日志的 head 处，
+// 日志头（含本次提交的 CRC）与数据块一起下发，一次等待。
+// 调用者已把 committing 置 1 且不持有 fslog.lock；不等待安装。
+static void commit(void)
+{
+    int n = fslog.n;
+    if (n == 0)
         return;
-    log_inited = 1;
+
+    acquire(&fslog.lock);
+    // 持有 head_busy 直到数据与日志头都落盘，检查点不会读到未写完的槽位
+    head_lock();
+    int head = (fslog.dh.tail + fslog.dh.n) % LOGBLOCKS;
+    uint crc = 0;
+    for (int i = 0; i < n; i++)
+    {
+        // 取代同一块在更早槽位中的版本（恢复时按槽位顺序重放，新版本覆盖旧版本）
+        for (int j = 0; j < fslog.dh.n; j++)
+        {
+            int old = (fslog.dh.tail + j) % LOGBLOCKS;
+            if (!fslog.stale[old] && fslog.dh.block[old] == fslog.block[i])
+            {
+                fslog.stale[old] = 1;
+                bunpin(fslog.cbufs[old]);
+                fslog.cbufs[old] = 0;
+                g_ckpt_absorbed++;
+            }
+        }
+        int slot = (head + i) % LOGBLOCKS;
+        fslog.dh.block[slot] = fslog.block[i];
+        fslog.stale[slot] = 0;
+        fslog.cbufs[slot] = fslog.bufs[i]; // 事务的钉住转交给已提交槽位
+        crc = crc32c(crc, fslog.bufs[i]->data, BSIZE);
+    }
+    fslog.dh.n += n;
+    fslog.dh.txn_start = head;
+    fslog.dh.txn_n = n;
+    fslog.dh.txn_crc = crc;
+    struct logheader lh = fslog.dh;
+    release(&fslog.lock);
+
+    for (int i = 0; i < n; i++)
+    {
+        bio_initbuf(&logio[i], fslog.start + 1 + (head + i) % LOGBLOCKS, fslog.bufs[i]->data);
+        bio_submit(&logio[i], BIO_WRITE, 0);
+    }
+    submit_head(&lh);
+    bio_flush();
+    for (int i = 0; i < n; i++)
+        bio_wait(&logio[i]);
+    bio_wait(&headio);
+    g_log_blocks += n;
+
+    acquire(&fslog.lock);
+    for (int i = 0; i < n; i++)
+        fslog.bufs[i] = 0;
+    fslog.n = 0;
+    head_unlock();
+    if (fslog.dh.n >= CKPT_THRESH)
+        wakeup(&fslog.dh);
+    release(&fslog.lock);
+    g_log_commits++;
+}
+
+// 检查点：安装当前全部已提交槽位，持久化推进后的 tail 后才释放这些槽位，
+// 避免崩溃时旧日志头指向已被新提交覆盖的槽位。
+static void checkpoint(void)
+{
+    acquire(&fslog.lock);
+    while (fslog.ckpt_running)
+        sleep(&fslog.ckpt_running, &fslog.lock);
+    fslog.ckpt_running = 1;
+    head_lock(); // 等待进行中的提交落盘
+    struct logheader lh = fslog.dh;
+    head_unlock();
+    release(&fslog.lock);
+
+    int k = lh.n;
+    if (k > 0)
+    {
+        g_ckpt_installs += install_slots(&lh, k);
+
+        acquire(&fslog.lock);
+        head_lock();
+        // 安装期间可能有新的提交，取当前状态并推进 tail
+        lh = fslog.dh;
+        for (int i = 0; i < k; i++)
+            lh.block[(lh.tail + i) % LOGBLOCKS] = 0;
+        lh.tail = (lh.tail + k) % LOGBLOCKS;
+        lh.n -= k;
+        if (lh.n == 0)
+            lh.txn_n = 0; // 最近一次提交也已安装
+        release(&fslog.lock);
+
+        write_head(&lh);
+
+        acquire(&fslog.lock);
+        for (int i = 0; i < k; i++)
+        {
+            int slot = (fslog.dh.tail + i) % LOGBLOCKS;
+            if (fslog.cbufs[slot])
+                bunpin(fslog.cbufs[slot]);
+            fslog.cbufs[slot] = 0;
+            fslog.stale[slot] = 0;
+        }
+        fslog.dh = lh;
+        head_unlock();
+        release(&fslog.lock);
+    }
+
+    acquire(&fslog.lock);
+    fslog.ckpt_running = 0;
+    wakeup(&fslog.ckpt_running);
+    wakeup(&fslog); // begin_op 可能在等待日志空间
+    release(&fslog.lock);
 }
 
-void begin_op(void) {}
-void end_op(void) {}
-void log_write(struct buf *b) {}
+// 后台 checkpointer：已提交槽位积累到 CKPT_THRESH 时安装并回收；
+// 打开的组中有已登记的块时，等到 LOG_COMMIT_DELAY 到期后强制提交
+static void checkpoint_thread(void)
+{
+    for (;;)
+    {
+        acquire(&fslog.lock);
+        while (fslog.dh.n < CKPT_THRESH && fslog.n == 0)
+            sleep(&fslog.dh, &fslog.lock);
+        int ckpt = fslog.dh.n >= CKPT_THRESH;
+        uint64 due = fslog.group_start + LOG_COMMIT_DELAY;
+        release(&fslog.lock);
+
+        if (ckpt)
+        {
+            checkpoint();
+            continue;
+        }
+        if (get_time() < due)
+            sleep_until(due);
+        acquire(&fslog.lock);
+        int late = fslog.n > 0 && get_time() - fslog.group_start >= LOG_COMMIT_DELAY;
+        release(&fslog.lock);
+        if (late)
+            log_force();
+    }
+}
+
+// 启动后台 checkpointer，由 fs_init 在挂载时调用；已在运行时不重复启动。
+// 进程系统尚未初始化时不启动：日志空间不足由 begin_op 同步做检查点，
+// 提交延迟只由下一次 end_op 或 log_force 限制
+void log_start_checkpointer(void)
+{
+    if (!proc_ready())
+        return;
+    if (fslog.checkpointer && findproc(fslog.checkpointer))
+        return;
+    int pid = create_process(checkpoint_thread);
+    fslog.checkpointer = pid > 0 ? pid : 0;
+}
+
+// 提交当前组：调用者已把 committing 置 1 并释放 fslog.lock，
+// 返回时重新持有 fslog.lock
+static void group_commit(void)
+{
+    commit();
+    bfree_commit(); // 释放已随提交落盘，这些块可以重新分配
+    acquire(&fslog.lock);
+    fslog.committing = 0;
+    fslog.grouped = 0;
+    wakeup(&fslog);
+}
+
+// 每个文件系统操作开始时调用，预留 MAXOPBLOCKS 个日志块
+void begin_op(void)
+{
+    acquire(&fslog.lock);
+    while (1)
+    {
+        int avail = LOGBLOCKS - fslog.dh.n;
+        if (fslog.committing)
+        {
+            sleep(&fslog, &fslog.lock);
+        }
+        else if (fslog.n + (fslog.outstanding + 1) * MAXOPBLOCKS > avail)
+        {
+            if (fslog.outstanding > 0)
+            {
+                // 等待进行中的操作结束并提交
+                sleep(&fslog, &fslog.lock);
+            }
+            else if (fslog.n > 0)
+            {
+                // 先提交已结束、尚未提交的组
+                fslog.committing = 1;
+                release(&fslog.lock);
+                group_commit();
+            }
+            else if (fslog.ckpt_running)
+            {
+                sleep(&fslog, &fslog.lock);
+            }
+            else
+            {
+                // 已提交的槽位占满日志：就地做检查点腾出空间
+                release(&fslog.lock);
+                checkpoint();
+                acquire(&fslog.lock);
+            }
+        }
+        else
+        {
+            fslog.outstanding += 1;
+            release(&fslog.lock);
+            return;
+        }
+    }
+}
+
+// 每个文件系统操作结束时调用；最后一个操作结束且组已满或已等待过久时提交
+void end_op(void)
+{
+    int do_commit = 0;
+
+    acquire(&fslog.lock);
+    fslog.outstanding -= 1;
+    fslog.grouped += 1;
+    g_log_ops++;
+    if (fslog.committing)
+        panic("log.committing");
+    if (fslog.outstanding == 0)
+    {
+        if (fslog.grouped >= LOGGROUP ||
+            fslog.n + MAXOPBLOCKS > LOGBLOCKS - fslog.dh.n ||
+            (fslog.n > 0 && get_time() - fslog.group_start >= LOG_COMMIT_DELAY))
+        {
+            do_commit = 1;
+            fslog.committing = 1;
+        }
+    }
+    else
+    {
+        // begin_op 可能在等待日志空间，outstanding 减少后可以重新检查
+        wakeup(&fslog);
+    }
+    release(&fslog.lock);
+
+    if (do_commit)
+    {
+        // 提交涉及磁盘 I/O 与睡眠，不能持有自旋锁
+        group_commit();
+        release(&fslog.lock);
+    }
+}
+
+// 强制提交当前组（例如需要持久化保证时），不等待安装
+void log_force(void)
+{
+    acquire(&fslog.lock);
+    while (fslog.committing || fslog.outstanding > 0)
+        sleep(&fslog, &fslog.lock);
+    if (fslog.n == 0 && fslog.grouped == 0)
+    {
+        release(&fslog.lock);
+        return;
+    }
+    fslog.committing = 1;
+    release(&fslog.lock);
+    group_commit();
+    release(&fslog.lock);
+}
+
+// 提交并安装全部日志内容（卸载或测试时使用）
+void log_checkpoint(void)
+{
+    log_force();
+    checkpoint();
+}
+
+// 代替 bwrite：登记 b 已被修改，并把它钉在缓存中直到安装。
+// 同一事务组内重复修改同一块只占一个日志槽位（吸收）。典型用法：
+//   bp = bread(...)
+//   修改 bp->data[]
+//   log_write(bp)
+//   brelse(bp)
+void log_write(struct buf *b)
+{
+    int i;
+
+    acquire(&fslog.lock);
+    if (fslog.n >= LOGBLOCKS - fslog.dh.n || fslog.n >= fslog.size - 1)
+        panic("too big a transaction");
+    if (fslog.outstanding < 1)
+        panic("log_write outside of trans");
+
+    for (i = 0; i < fslog.n; i++)
+    {
+        if (fslog.block[i] == b->blockno) // log absorption
+            break;
+    }
+    if (i == fslog.n)
+    {
+        if (fslog.n == 0)
+        {
+            // 组内第一个块：开始计算提交延迟，唤醒 checkpointer 计时
+            fslog.group_start = get_time();
+            if (fslog.checkpointer)
+                wakeup(&fslog.dh);
+        }
+        fslog.block[i] = b->blockno;
+        fslog.bufs[i] = b;
+        bpin(b);
+        fslog.n++;
+    }
+    release(&fslog.lock);
+}
+
+// 块是否已登记在尚未安装的事务中（其磁盘内容尚未更新）
+int log_holds(uint blockno)
+{
+    int found = 0;
+    acquire(&fslog.lock);
+    for (int i = 0; i < fslog.n && !found; i++)
+    {
+        if (fslog.block[i] == (int)blockno)
+            found = 1;
+    }
+    for (int i = 0; i < fslog.dh.n && !found; i++)
+    {
+        int slot = (fslog.dh.tail + i) % LOGBLOCKS;
+        if (!fslog.stale[slot] && fslog.dh.block[slot] == (int)blockno)
+            found = 1;
+    }
+    release(&fslog.lock);
+    return found;
+}
+
+int log_commit_count(void)
+{
+    return g_log_commits;
+}
+
+int log_op_count(void)
+{
+    return g_log_ops;
+}
+
+int log_block_count(void)
+{
+    return g_log_blocks;
+}
+
+int log_ckpt_installs(void)
+{
+    return g_ckpt_installs;
+}
+
+int log_ckpt_absorbed(void)
+{
+    return g_ckpt_absorbed;
+}
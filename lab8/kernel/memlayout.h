@@ -58,3 +58,13 @@
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// shared memory segments (shm.c): segment id i is mapped at the same
+// fixed window SHMVA(i) in every process that attaches it, far above
+// the user heap.
+#define SHMBASE 0x2000000000L
+#define SHMVA(id) (SHMBASE + (uint64)(id) * SHM_MAXPAGES * PGSIZE)
+
+// file mappings (mmap.c) are placed upward from MMAPBASE, below the
+// shared memory windows.
+#define MMAPBASE 0x1000000000L
@@ -0,0 +1,182 @@
+// kernel/mmap.c
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "mmap.h"
+#include "printf.h"
+#include "log.h"
+
+// 文件映射：mmap 只登记区域，不建立任何页表项；
+// 第一次访问触发缺页，由 mmap_fault 把页缓存中的物理页直接映射进用户页表，
+// 读取路径上不再有 readi -> memmove 的拷贝和系统调用开销。
+// 支持的访问方式：
+//   - 用户态 load/store/取指：缺页进入 usertrap，由 mmap_fault 建立映射后重新执行；
+//   - 系统调用访问用户缓冲区（copyin/copyout、futex）：内核不经用户页表访问，
+//     不会缺页，由这些路径在访问前显式调用 mmap_fault；
+//   - 内核直接解引用用户地址不受支持（kerneltrap 不处理 mmap 缺页）。
+
+static struct vma *vma_find(struct proc *p, uint64 va)
+{
+    for (int i = 0; i < NVMA; i++)
+    {
+        struct vma *v = &p->vma[i];
+        if (v->used && va >= v->start && va < v->start + v->len)
+            return v;
+    }
+    return 0;
+}
+
+// 在进程 p 中映射文件 ip 从 off 开始的 len 字节，返回起始虚拟地址，失败返回 0
+uint64 mmap_file(struct proc *p, struct inode *ip, uint off, uint64 len, int prot, int flags)
+{
+    if (p == 0 || p->pagetable == 0 || ip == 0 || len == 0)
+        return 0;
+    if ((off % PGSIZE) != 0 || !(prot & PROT_READ))
+        return 0;
+    if (flags != MAP_SHARED && flags != MAP_PRIVATE)
+        return 0;
+    // 共享映射直接使用缓存页，不支持写回文件
+    if (flags == MAP_SHARED && (prot & PROT_WRITE))
+        return 0;
+
+    struct vma *v = 0;
+    for (int i = 0; i < NVMA; i++)
+    {
+        if (!p->vma[i].used)
+        {
+            v = &p->vma[i];
+            break;
+        }
+    }
+    if (v == 0)
+        return 0;
+
+    if (p->mmaptop < MMAPBASE)
+        p->mmaptop = MMAPBASE;
+    len = PGROUNDUP(len);
+    if (p->mmaptop + len > SHMBASE)
+        return 0;
+
+    v->used = 1;
+    v->start = p->mmaptop;
+    v->len = len;
+    v->prot = prot;
+    v->flags = flags;
+    v->ip = iget(ip->dev, ip->inum);
+    v->off = off;
+    p->mmaptop += len;
+
+    klog(LOG_LEVEL_DEBUG, "mmap: pid=%d inum=%d off=%d len=%d va=%p",
+         p->pid, (int)ip->inum, (int)off, (int)len, (void *)v->start);
+    return v->start;
+}
+
+// 取消映射 [va, va+len)，只支持移除整个区域或从区域首/尾截断
+int munmap_file(struct proc *p, uint64 va, uint64 len)
+{
+    if (p == 0 || (va % PGSIZE) != 0 || len == 0)
+        return -1;
+    len = PGROUNDUP(len);
+
+    struct vma *v = vma_find(p, va);
+    if (v == 0 || va + len > v->start + v->len)
+        return -1;
+    if (va != v->start && va + len != v->start + v->len)
+        return -1;
+
+    // 已建立的映射各自持有物理页引用（缓存页或私有副本），一并释放
+    unmap_range(p->pagetable, va, len / PGSIZE, 1);
+
+    if (va == v->start)
+    {
+        v->start += len;
+        v->off += len;
+    }
+    v->len -= len;
+    if (v->len == 0)
+    {
+        iput(v->ip);
+        v->ip = 0;
+        v->used = 0;
+    }
+    return 0;
+}
+
+// 进程退出时释放所有文件映射
+void mmap_release(struct proc *p)
+{
+    for (int i = 0; i < NVMA; i++)
+    {
+        struct vma *v = &p->vma[i];
+        if (v->used)
+            munmap_file(p, v->start, v->len);
+    }
+    p->mmaptop = MMAPBASE;
+}
+
+// 处理 mmap 区域内的缺页，write 非零表示 store 缺页
+// 返回 0 表示已建立映射，-1 表示不是合法的 mmap 访问
+int mmap_fault(struct proc *p, uint64 va, int write)
+{
+    if (p == 0 || p->pagetable == 0)
+        return -1;
+    struct vma *v = vma_find(p, va);
+    if (v == 0)
+        return -1;
+    if (write && !(v->prot & PROT_WRITE))
+        return -1;
+
+    uint64 a = PGROUNDDOWN(va);
+    uint pgoff = (v->off + (a - v->start)) / PGSIZE;
+    pte_t *pte = walk_lookup(p->pagetable, a);
+
+    if (write)
+    {
+        // 私有可写映射：写时复制出私有页
+        char *page = (char *)alloc_page();
+        if (page == 0)
+            return -1;
+        if (pte && (*pte & PTE_V))
+        {
+            uint64 old = PTE2PA(*pte);
+            memmove(page, (void *)old, PGSIZE);
+            *pte = PA2PTE(page) | PTE_R | PTE_W | PTE_U | PTE_V;
+            free_page((void *)old); // 归还对缓存页的引用
+            sfence_vma();
+            return 0;
+        }
+        uint64 pa = pcache_get(v->ip, pgoff);
+        if (pa == 0)
+        {
+            free_page(page);
+            return -1;
+        }
+        memmove(page, (void *)pa, PGSIZE);
+        if (map_page(p->pagetable, a, (uint64)page, PTE_R | PTE_W | PTE_U) < 0)
+        {
+            free_page(page);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (pte && (*pte & PTE_V))
+        return 0; // 已映射（例如其他路径抢先处理）
+
+    // 读缺页：直接映射页缓存中的物理页（只读），零拷贝
+    uint64 pa = pcache_get(v->ip, pgoff);
+    if (pa == 0)
+        return -1;
+    int perm = PTE_R | PTE_U;
+    if (v->prot & PROT_EXEC)
+        perm |= PTE_X;
+    if (map_page(p->pagetable, a, pa, perm) < 0)
+        return -1;
+    page_ref_inc((void *)pa);
+    return 0;
+}
@@ -0,0 +1,28 @@
+// kernel/mmap.h
+#ifndef MMAP_H
+#define MMAP_H
+
+#include "types.h"
+
+// mmap 保护位
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC 0x4
+
+// mmap 映射类型：只支持只读共享映射与写时复制的私有映射
+#define MAP_SHARED 0x1
+#define MAP_PRIVATE 0x2
+
+// 进程内一段文件映射区域，页面在缺页时按需从页缓存建立
+struct vma
+{
+    int used;
+    uint64 start;      // 起始虚拟地址（页对齐）
+    uint64 len;        // 长度（字节，页对齐）
+    int prot;          // PROT_*
+    int flags;         // MAP_*
+    struct inode *ip;  // 被映射的文件（持有一个 iget 引用）
+    uint off;          // start 对应的文件偏移（页对齐）
+};
+
+#endif
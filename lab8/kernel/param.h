@@ -1,14 +1,28 @@
 #define NPROC 64                    // maximum number of processes
 #define NCPU 8                      // maximum number of CPUs
+#define NMLFQ 3                     // scheduler priority levels (0 = highest)
+#define MLFQ_QUANTUM 1              // level-0 time allotment (timer ticks), doubles per level
+#define MLFQ_BOOST 50               // timer ticks between priority boosts
 #define NOFILE 16                   // open files per process
 #define NFILE 100                   // open files per system
 #define NINODE 50                   // maximum number of active i-nodes
+#define NDENTRY 64                  // cached pathname lookups (dcache)
 #define NDEV 10                     // maximum major device number
 #define ROOTDEV 1                   // device number of file system root disk
 #define MAXARG 32                   // max exec arguments
 #define MAXOPBLOCKS 10              // max # of blocks any FS op writes
 #define LOGBLOCKS (MAXOPBLOCKS * 3) // max data blocks in on-disk log
-#define NBUF (MAXOPBLOCKS * 3)      // size of disk block cache
+#define NBUF (LOGBLOCKS + MAXOPBLOCKS * 2) // size of disk block cache (logged blocks stay pinned)
+#define LOGGROUP 8                  // max fs operations grouped into one log commit
+#define LOG_COMMIT_DELAY 1000000    // max cycles a logged op waits for its group commit
 #define FSSIZE 2000                 // size of file system in blocks
+#define SCRATCHBLOCKS 16            // blocks at the end of the disk kept outside the fs, for raw I/O tests
 #define MAXPATH 128                 // maximum file path name
 #define USERSTACK 1                 // user stack pages
+#define NSHM 16                     // maximum number of shared memory segments
+#define SHM_MAXPAGES 64             // max pages per shared memory segment
+#define NVMA 8                      // mmap regions per process
+#define NPCACHE 64                  // file pages kept in the page cache
+#define NDIRTYMAX (NPCACHE / 2)     // dirty pages before writei forces writeback
+#define RA_INITPAGES 4              // initial sequential readahead window (pages)
+#define RA_MAXPAGES 16              // max sequential readahead window (pages)
@@ -0,0 +1,463 @@
+// kernel/pcache.c
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "printf.h"
+
+// 文件数据页缓存，与 bio.c 的元数据 buf 缓存分离。
+// 每个 inode 一棵基数树（ip->pc_root），按文件页号索引到 struct cpage；
+// 树的每个节点是一整页，含 PC_FANOUT 个槽位，高度随文件增大而增长。
+// 所有 cpage 组成一个全局池，按 LRU 淘汰。缓存持有每个数据页的一个引用（page_ref），
+// mmap 的映射者各自再持有一个引用，因此淘汰缓存项不会影响仍在映射中的页面。
+// 写入采用延迟分配的写回（write-back）：writei 只修改缓存页并标记为脏，此时页面还没有
+// 磁盘块；iflush 为连续的脏页一次分配连续的块后由 pcache_writeback 批量写回。
+// 脏页不会被淘汰。
+// 磁盘 I/O 从不在持有 pcache_lock 时进行：读入前先把页面标记为 reading 插入树中，
+// 放锁后提交读请求，完成回调清除标记并唤醒等待者；写回期间页面标记为 writing。
+// 有 I/O 在途的页面不会被淘汰；读到 reading 页面的访问者等待该页完成后重新查找。
+#define PC_SHIFT 9
+#define PC_FANOUT (1 << PC_SHIFT)
+
+struct cpage
+{
+    int used;
+    struct inode *ip;    // 所属 inode
+    uint pgoff;          // 文件页号
+    uint64 pa;           // 缓存页物理地址
+    uint64 lastuse;      // LRU 时间戳
+    int readahead;       // 由预读读入且尚未被访问
+    int dirty;           // 已修改、尚未写回
+    int reading;         // 正在从磁盘读入，内容尚不可用
+    int writing;         // 正在写回磁盘
+    struct buf io;       // 该页的块 I/O
+};
+
+static struct cpage cpages[NPCACHE];
+static struct spinlock pcache_lock;
+static uint64 pcache_clock;
+static int g_pc_hits = 0;
+static int g_pc_misses = 0;
+static int g_ra_hits = 0;   // 预读页随后被读到
+static int g_ra_wasted = 0; // 预读页未被访问就被淘汰
+static int g_dirty = 0;     // 全部脏页数
+
+void pcache_init(void)
+{
+    initlock(&pcache_lock, "pcache");
+    for (int i = 0; i < NPCACHE; i++)
+    {
+        cpages[i].used = 0;
+        cpages[i].ip = 0;
+        cpages[i].reading = 0;
+        cpages[i].writing = 0;
+    }
+    pcache_clock = 0;
+    g_pc_hits = 0;
+    g_pc_misses = 0;
+    g_ra_hits = 0;
+    g_ra_wasted = 0;
+    g_dirty = 0;
+}
+
+// 查找 pgoff 对应的槽位；create 非零时按需增高树并分配中间节点
+static void **pc_slot(struct inode *ip, uint pgoff, int create)
+{
+    // 高度为 h 的树可索引 2^(9h) 页
+    while (ip->pc_height == 0 || (ip->pc_height < 4 && (pgoff >> (PC_SHIFT * ip->pc_height)) != 0))
+    {
+        if (!create)
+            return 0;
+        void **n = (void **)alloc_page();
+        if (n == 0)
+            return 0;
+        memset(n, 0, PGSIZE);
+        // 原根节点成为新根的第 0 个孩子
+        n[0] = ip->pc_root;
+        ip->pc_root = n;
+        ip->pc_height++;
+    }
+
+    void **node = (void **)ip->pc_root;
+    for (int h = ip->pc_height - 1; h > 0; h--)
+    {
+        int idx = (pgoff >> (PC_SHIFT * h)) & (PC_FANOUT - 1);
+        if (node[idx] == 0)
+        {
+            if (!create)
+                return 0;
+            void **n = (void **)alloc_page();
+            if (n == 0)
+                return 0;
+            memset(n, 0, PGSIZE);
+            node[idx] = n;
+        }
+        node = (void **)node[idx];
+    }
+    return &node[pgoff & (PC_FANOUT - 1)];
+}
+
+static struct cpage *pc_lookup(struct inode *ip, uint pgoff)
+{
+    void **slot = pc_slot(ip, pgoff, 0);
+    return slot ? (struct cpage *)*slot : 0;
+}
+
+// 从所属 inode 的树中摘除并释放缓存对页面的引用，调用者持有 pcache_lock
+static void pc_evict(struct cpage *c)
+{
+    void **slot = pc_slot(c->ip, c->pgoff, 0);
+    if (slot)
+        *slot = 0;
+    if (c->readahead)
+        g_ra_wasted++;
+    if (c->dirty)
+    {
+        c->ip->ndirty--;
+        g_dirty--;
+        c->dirty = 0;
+    }
+    free_page((void *)c->pa);
+    c->used = 0;
+    c->ip = 0;
+}
+
+// 选择空闲项，否则淘汰最久未使用的干净页；全部是脏页或有 I/O 在途时返回 0。调用者持有 pcache_lock
+static struct cpage *pc_alloc(void)
+{
+    struct cpage *victim = 0;
+    for (struct cpage *c = cpages; c < &cpages[NPCACHE]; c++)
+    {
+        if (!c->used)
+            return c;
+        if (!c->dirty && !c->reading && !c->writing && (victim == 0 || c->lastuse < victim->lastuse))
+            victim = c;
+    }
+    if (victim)
+        pc_evict(victim);
+    return victim;
+}
+
+// 页面 I/O 完成回调，在中断（或 bio_wait 轮询）上下文中运行。
+// pcache_lock 的持有者都关中断且不会等待 I/O，因此这里不取锁也不会与之交错。
+static void pc_endio(struct buf *b)
+{
+    struct cpage *c = (struct cpage *)((char *)b - __builtin_offsetof(struct cpage, io));
+    c->reading = 0;
+    c->writing = 0;
+    wakeup(c);
+}
+
+// 等待页面 c 上的 I/O 推进，调用者持有 pcache_lock，返回时仍持有。
+// 期间锁会被释放，c 可能已完成、被淘汰或复用，调用者须重新检查
+static void pc_waitio(struct cpage *c)
+{
+    if (cansleep())
+    {
+        sleep(c, &pcache_lock);
+        return;
+    }
+    release(&pcache_lock);
+    bio_flush();
+    virtio_disk_intr();
+    acquire(&pcache_lock);
+}
+
+// 为 reading 状态的页面 c 读入文件第 pgoff 页（空洞清零），不持有 pcache_lock。
+// sync 非零时等待读入完成，否则只提交请求，由 pc_endio 清除 reading
+static void pc_fill(struct cpage *c, struct inode *ip, uint pgoff, int sync)
+{
+    uint bnum = bmap_peek(ip, pgoff);
+    if (bnum)
+    {
+        bio_initbuf(&c->io, bnum, (void *)c->pa);
+        bio_submit(&c->io, BIO_READ, pc_endio);
+        if (sync)
+            bio_wait(&c->io);
+        return;
+    }
+    memset((void *)c->pa, 0, PGSIZE);
+    // 内联文件（mmap 时）：内容在 inode 中
+    if (INODE_INLINE(ip) && pgoff == 0)
+        memmove((void *)c->pa, ip->addrs, ip->size);
+    acquire(&pcache_lock);
+    c->reading = 0;
+    wakeup(c);
+    release(&pcache_lock);
+}
+
+// 为文件第 pgoff 页分配新的缓存项并插入树中，fill 非零时标记为 reading。调用者持有 pcache_lock
+static struct cpage *pc_insert(struct inode *ip, uint pgoff, int fill)
+{
+    void **slot = pc_slot(ip, pgoff, 1);
+    if (slot == 0)
+        return 0;
+    char *page = (char *)alloc_page();
+    if (page == 0)
+        return 0;
+    struct cpage *c = pc_alloc();
+    if (c == 0)
+    {
+        free_page(page);
+        return 0;
+    }
+    // 淘汰可能释放了 slot 所在的叶子槽位内容，但不会释放树节点，slot 仍然有效
+    c->used = 1;
+    c->ip = ip;
+    c->pgoff = pgoff;
+    c->pa = (uint64)page;
+    c->lastuse = ++pcache_clock;
+    c->readahead = 0;
+    c->dirty = 0;
+    c->reading = fill;
+    c->writing = 0;
+    *slot = c;
+    return c;
+}
+
+// 取得文件第 pgoff 页的缓存项；未命中时分配新页，fill 非零则从磁盘读入（空洞清零）。
+// 调用者持有 pcache_lock；读盘期间锁被释放
+static struct cpage *pc_getpage(struct inode *ip, uint pgoff, int fill)
+{
+    for (;;)
+    {
+        struct cpage *c = pc_lookup(ip, pgoff);
+        if (c && c->reading)
+        {
+            pc_waitio(c);
+            continue;
+        }
+        if (c)
+        {
+            c->lastuse = ++pcache_clock;
+            g_pc_hits++;
+            if (c->readahead)
+            {
+                c->readahead = 0;
+                g_ra_hits++;
+            }
+            return c;
+        }
+
+        if ((c = pc_insert(ip, pgoff, fill)) == 0)
+            return 0;
+        g_pc_misses++;
+        if (!fill)
+            return c;
+        release(&pcache_lock);
+        pc_fill(c, ip, pgoff, 1);
+        acquire(&pcache_lock);
+        // 放锁期间页面可能已被淘汰，此时重新查找
+        if (c->used && c->ip == ip && c->pgoff == pgoff && !c->reading)
+            return c;
+    }
+}
+
+// 获取文件第 pgoff 页的缓存页物理地址（供 mmap 直接映射）
+// 返回的页由缓存持有引用；调用者若要映射该页，需自行 page_ref_inc
+uint64 pcache_get(struct inode *ip, uint pgoff)
+{
+    acquire(&pcache_lock);
+    struct cpage *c = pc_getpage(ip, pgoff, 1);
+    uint64 pa = c ? c->pa : 0;
+    release(&pcache_lock);
+    return pa;
+}
+
+// 从文件第 pgoff 页的 boff 处读取 n 字节（不跨页）
+int pcache_read(struct inode *ip, uint pgoff, uint boff, char *dst, uint n)
+{
+    acquire(&pcache_lock);
+    struct cpage *c = pc_getpage(ip, pgoff, 1);
+    if (c == 0)
+    {
+        release(&pcache_lock);
+        return -1;
+    }
+    memmove(dst, (char *)c->pa + boff, n);
+    release(&pcache_lock);
+    return n;
+}
+
+// 向文件第 pgoff 页的 boff 处写入 n 字节并标记为脏页（不跨页），不分配磁盘块
+// 整页覆盖时不需要先从磁盘读入旧内容；缓存中全是脏页时返回 -1
+int pcache_write(struct inode *ip, uint pgoff, uint boff, char *src, uint n)
+{
+    acquire(&pcache_lock);
+    struct cpage *c = pc_getpage(ip, pgoff, !(boff == 0 && n == PGSIZE));
+    if (c == 0)
+    {
+        release(&pcache_lock);
+        return -1;
+    }
+    memmove((char *)c->pa + boff, src, n);
+    if (!c->dirty)
+    {
+        c->dirty = 1;
+        ip->ndirty++;
+        g_dirty++;
+    }
+    release(&pcache_lock);
+    return n;
+}
+
+// 找出 inode 页号最小的脏页，返回从它开始连续脏页的个数（至多 max），*pgoff 为起始页号
+uint pcache_dirty_run(struct inode *ip, uint *pgoff, uint max)
+{
+    acquire(&pcache_lock);
+    struct cpage *first = 0;
+    for (struct cpage *c = cpages; c < &cpages[NPCACHE]; c++)
+    {
+        if (c->used && c->dirty && c->ip == ip && (first == 0 || c->pgoff < first->pgoff))
+            first = c;
+    }
+    uint n = 0;
+    if (first)
+    {
+        *pgoff = first->pgoff;
+        struct cpage *c;
+        while (n < max && (c = pc_lookup(ip, first->pgoff + n)) != 0 && c->dirty)
+            n++;
+    }
+    release(&pcache_lock);
+    return n;
+}
+
+// 把 [pgoff, pgoff+n) 的脏页写回到 bnums 给出的磁盘块并清除脏标记。
+// 各页一起异步提交，连续的块在块层合并成多段请求；提交与等待都不持有 pcache_lock。
+void pcache_writeback(struct inode *ip, uint pgoff, uint n, uint *bnums)
+{
+    struct cpage *wbpages[NPCACHE];
+    int nwb = 0;
+
+    acquire(&pcache_lock);
+    for (uint i = 0; i < n && nwb < NPCACHE; i++)
+    {
+        struct cpage *c = pc_lookup(ip, pgoff + i);
+        // 上一次写回尚未完成时又被写脏：等它写完再重新提交
+        if (c && c->writing)
+        {
+            pc_waitio(c);
+            i--;
+            continue;
+        }
+        if (c == 0 || !c->dirty)
+            continue;
+        bio_initbuf(&c->io, bnums[i], (void *)c->pa);
+        c->writing = 1;
+        c->dirty = 0;
+        ip->ndirty--;
+        g_dirty--;
+        wbpages[nwb++] = c;
+    }
+    release(&pcache_lock);
+
+    for (int i = 0; i < nwb; i++)
+        bio_submit(&wbpages[i]->io, BIO_WRITE, pc_endio);
+    bio_flush();
+
+    // 写回中的页面不会被淘汰，writing 清除即本页写完
+    acquire(&pcache_lock);
+    for (int i = 0; i < nwb; i++)
+    {
+        while (wbpages[i]->writing)
+            pc_waitio(wbpages[i]);
+    }
+    release(&pcache_lock);
+}
+
+int pcache_dirty_count(void)
+{
+    return g_dirty;
+}
+
+// 预读：把 [pgoff, pgoff+npages) 中尚未缓存的页提前读入页缓存并标记为预读页。
+// 已缓存的页不计入命中统计，也不刷新其 LRU 位置。
+// 各页的读请求一起异步提交，相邻磁盘块在块层合并，不等待完成即返回：
+// 页面在读入完成前保持 reading，之后访问到它的读者只等待这一页。
+void pcache_readahead(struct inode *ip, uint pgoff, uint npages)
+{
+    struct cpage *rapages[RA_MAXPAGES];
+    int nra = 0;
+
+    if (npages > RA_MAXPAGES)
+        npages = RA_MAXPAGES;
+
+    acquire(&pcache_lock);
+    for (uint pg = pgoff; pg < pgoff + npages; pg++)
+    {
+        if (pc_lookup(ip, pg))
+            continue;
+        struct cpage *c = pc_insert(ip, pg, 1);
+        if (c == 0)
+            break;
+        c->readahead = 1;
+        rapages[nra++] = c;
+    }
+    release(&pcache_lock);
+
+    for (int i = 0; i < nra; i++)
+        pc_fill(rapages[i], ip, rapages[i]->pgoff, 0);
+    bio_flush();
+}
+
+static void pc_freetree(void **node, int height)
+{
+    if (height > 1)
+    {
+        for (int i = 0; i < PC_FANOUT; i++)
+        {
+            if (node[i])
+                pc_freetree((void **)node[i], height - 1);
+        }
+    }
+    free_page(node);
+}
+
+// 丢弃 inode 的全部缓存页与基数树（inode 被释放或重新分配时调用），脏页也被丢弃
+void pcache_drop(struct inode *ip)
+{
+    acquire(&pcache_lock);
+    for (int i = 0; i < NPCACHE; i++)
+    {
+        struct cpage *c = &cpages[i];
+        if (!c->used || c->ip != ip)
+            continue;
+        // 不能释放 I/O 在途的页面；等待期间其他项可能变化，从头重新扫描
+        if (c->reading || c->writing)
+        {
+            pc_waitio(c);
+            i = -1;
+            continue;
+        }
+        pc_evict(c);
+    }
+    if (ip->pc_root)
+        pc_freetree((void **)ip->pc_root, ip->pc_height);
+    ip->pc_root = 0;
+    ip->pc_height = 0;
+    release(&pcache_lock);
+}
+
+int pcache_hits(void)
+{
+    return g_pc_hits;
+}
+
+int pcache_misses(void)
+{
+    return g_pc_misses;
+}
+
+int pcache_ra_hits(void)
+{
+    return g_ra_hits;
+}
+
+int pcache_ra_wasted(void)
+{
+    return g_ra_wasted;
+}
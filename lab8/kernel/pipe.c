@@ -0,0 +1,205 @@
+// kernel/pipe.c
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "file.h"
+#include "printf.h"
+
+// 管道：一整页内存，页首是控制信息，其余是单生产者/单消费者环形缓冲区。
+// head 只由写端推进、tail 只由读端推进，二者按 PIPEWRAP 取模计数，PIPE_USED 即环中字节数。
+// 写端先复制数据再发布 head，读端先复制数据再发布 tail，两端互不持锁即可并发传输。
+// 同一端有多个进程（fork 后共享 fd）时由该端自己的 wlock/rlock 串行化，不影响另一端。
+// 只有环为空（读者等待）或为满（写者等待）时才使用 lock 睡眠与唤醒：
+// 等待方先置等待标志再复查环，发布方先发布再检查标志，因此不会丢失唤醒，
+// 且对端没有等待时不做任何唤醒。
+struct pipe
+{
+    struct spinlock lock;  // 保护等待标志与两端的打开状态，睡眠/唤醒用
+    struct spinlock wlock; // 串行化写端
+    struct spinlock rlock; // 串行化读端
+    uint head;             // 已写入字节数模 PIPEWRAP（写端发布）
+    uint tail;             // 已读出字节数模 PIPEWRAP（读端发布）
+    int readopen;          // 读端仍然打开
+    int writeopen;         // 写端仍然打开
+    int rwait;             // 有读者在等待数据
+    int wwait;             // 有写者在等待空间
+};
+
+#define PIPESIZE (PGSIZE - 128)
+#define PIPEDATA(pi) ((char *)(pi) + 128)
+// PIPESIZE 不是 2 的幂，自由回绕的 uint 计数在 2^32 处会与 % PIPESIZE 错位。
+// 计数改为模 PIPEWRAP（PIPESIZE 的倍数）推进：下标仍为 % PIPESIZE，
+// 且满（PIPESIZE）与空（0）可以区分
+#define PIPEWRAP (2 * PIPESIZE)
+#define PIPE_USED(head, tail) (((head) + PIPEWRAP - (tail)) % PIPEWRAP)
+
+static int g_pipe_wakeups = 0;
+
+int pipealloc(struct file **rf, struct file **wf)
+{
+    struct pipe *pi = 0;
+    *rf = *wf = 0;
+    if (sizeof(struct pipe) > 128)
+        panic("pipealloc: header too large");
+    if ((pi = (struct pipe *)alloc_page()) == 0)
+        goto bad;
+    if ((*rf = filealloc()) == 0 || (*wf = filealloc()) == 0)
+        goto bad;
+    initlock(&pi->lock, "pipe");
+    initlock(&pi->wlock, "pipew");
+    initlock(&pi->rlock, "piper");
+    pi->head = 0;
+    pi->tail = 0;
+    pi->readopen = 1;
+    pi->writeopen = 1;
+    pi->rwait = 0;
+    pi->wwait = 0;
+    (*rf)->type = FD_PIPE;
+    (*rf)->readable = 1;
+    (*rf)->pipe = pi;
+    (*wf)->type = FD_PIPE;
+    (*wf)->writable = 1;
+    (*wf)->pipe = pi;
+    return 0;
+
+bad:
+    if (pi)
+        free_page(pi);
+    if (*rf)
+        fileclose(*rf);
+    if (*wf)
+        fileclose(*wf);
+    *rf = *wf = 0;
+    return -1;
+}
+
+void pipeclose(struct pipe *pi, int writable)
+{
+    acquire(&pi->lock);
+    if (writable)
+        pi->writeopen = 0;
+    else
+        pi->readopen = 0;
+    // 对端可能正在等待：写端关闭后读者读到 EOF，读端关闭后写者返回错误
+    wakeup(&pi->rwait);
+    wakeup(&pi->wwait);
+    int dead = !pi->readopen && !pi->writeopen;
+    release(&pi->lock);
+    if (dead)
+        free_page(pi);
+}
+
+// 发布后检查对端的等待标志，只有对端确实在等待时才唤醒
+static void pipe_kick(struct pipe *pi, int *flag)
+{
+    __sync_synchronize();
+    if (*(volatile int *)flag == 0)
+        return;
+    acquire(&pi->lock);
+    if (*flag)
+    {
+        *flag = 0;
+        wakeup(flag);
+        g_pipe_wakeups++;
+    }
+    release(&pi->lock);
+}
+
+// 环为空（reader）或为满时等待；置标志后复查一次，对端在此之前的发布不会被错过
+static void pipe_wait(struct pipe *pi, int *flag, int reader)
+{
+    acquire(&pi->lock);
+    *flag = 1;
+    __sync_synchronize();
+    uint used = PIPE_USED(*(volatile uint *)&pi->head, *(volatile uint *)&pi->tail);
+    int blocked = reader ? (used == 0 && pi->writeopen) : (used == PIPESIZE && pi->readopen);
+    if (blocked && !myproc()->killed)
+        sleep(flag, &pi->lock);
+    *flag = 0;
+    release(&pi->lock);
+}
+
+// 写入全部 n 字节，环满时等待读者；读端已关闭时返回已写入的字节数（一个都没写入则为 -1）
+int pipewrite(struct pipe *pi, char *addr, int n)
+{
+    char *data = PIPEDATA(pi);
+    int tot = 0;
+    while (tot < n)
+    {
+        if (!pi->readopen || myproc()->killed)
+            return tot > 0 ? tot : -1;
+
+        acquire(&pi->wlock);
+        uint head = pi->head;
+        uint tail = *(volatile uint *)&pi->tail;
+        __sync_synchronize(); // 读到 tail 之后才能覆盖读者已腾出的空间
+        uint m = PIPESIZE - PIPE_USED(head, tail);
+        if (m > (uint)(n - tot))
+            m = n - tot;
+        uint i = head % PIPESIZE;
+        uint first = m < PIPESIZE - i ? m : PIPESIZE - i;
+        memmove(data + i, addr + tot, first);
+        memmove(data, addr + tot + first, m - first);
+        __sync_synchronize(); // 数据先于 head 可见
+        *(volatile uint *)&pi->head = (head + m) % PIPEWRAP;
+        release(&pi->wlock);
+
+        if (m > 0)
+        {
+            tot += m;
+            pipe_kick(pi, &pi->rwait);
+        }
+        else
+        {
+            pipe_wait(pi, &pi->wwait, 0);
+        }
+    }
+    return tot;
+}
+
+// 读出至多 n 字节：环中有数据时立即返回，为空时等待；写端已关闭且环为空时返回 0
+int piperead(struct pipe *pi, char *addr, int n)
+{
+    char *data = PIPEDATA(pi);
+    for (;;)
+    {
+        if (myproc()->killed)
+            return -1;
+        // 写者先发布数据再关闭：先看到关闭，随后取到的 head 就是最终值
+        int wopen = pi->writeopen;
+        __sync_synchronize();
+
+        acquire(&pi->rlock);
+        uint tail = pi->tail;
+        uint head = *(volatile uint *)&pi->head;
+        __sync_synchronize(); // 读到 head 之后才能读取写者发布的数据
+        uint m = PIPE_USED(head, tail);
+        if (m > (uint)n)
+            m = n;
+        uint i = tail % PIPESIZE;
+        uint first = m < PIPESIZE - i ? m : PIPESIZE - i;
+        memmove(addr, data + i, first);
+        memmove(addr + first, data, m - first);
+        __sync_synchronize(); // 复制完成后才把空间还给写者
+        *(volatile uint *)&pi->tail = (tail + m) % PIPEWRAP;
+        release(&pi->rlock);
+
+        if (m > 0 || n == 0)
+        {
+            pipe_kick(pi, &pi->wwait);
+            return m;
+        }
+        if (!wopen)
+            return 0;
+        pipe_wait(pi, &pi->rwait, 1);
+    }
+}
+
+// 唤醒对端的次数（只在环空/满的边界发生）
+int pipe_wakeups(void)
+{
+    return g_pipe_wakeups;
+}
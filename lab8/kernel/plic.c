@@ -0,0 +1,44 @@
+// kernel/plic.c
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+
+//
+// the riscv Platform Level Interrupt Controller (PLIC).
+// 单核内核，只使用 hart 0 的 S 模式上下文。
+//
+
+void plicinit(void)
+{
+    // set desired IRQ priorities non-zero (otherwise disabled).
+    *(uint32 *)(PLIC + VIRTIO0_IRQ * 4) = 1;
+}
+
+void plicinithart(void)
+{
+    int hart = 0;
+
+    // set enable bits for this hart's S-mode
+    // for the virtio disk.
+    *(uint32 *)PLIC_SENABLE(hart) = (1 << VIRTIO0_IRQ);
+
+    // set this hart's S-mode priority threshold to 0.
+    *(uint32 *)PLIC_SPRIORITY(hart) = 0;
+}
+
+// ask the PLIC what interrupt we should serve.
+int plic_claim(void)
+{
+    int hart = 0;
+    int irq = *(uint32 *)PLIC_SCLAIM(hart);
+    return irq;
+}
+
+// tell the PLIC we've served this IRQ.
+void plic_complete(int irq)
+{
+    int hart = 0;
+    *(uint32 *)PLIC_SCLAIM(hart) = irq;
+}
@@ -8,6 +8,7 @@
 #include "printf.h"
 #include "defs.h"
 #include "log.h"
+#include "file.h"
 
 // 局部用户内存写入助手：用现有的 walkaddr + memmove 实现 copyout
 static int
@@ -41,12 +42,98 @@ struct cpu cpu;
 struct proc proc[NPROC];
 struct spinlock proc_lock;
 struct spinlock wait_lock;
+static int g_nswitch; // 调度器切换到进程的次数
+
+// pid 哈希表：kill 等按 pid 查找进程时只需遍历一条链。pid 顺序分配，取低位即均匀分布。
+// pid_lock 只保护哈希链，是最内层的锁（持有 p->lock 时也可以获取）
+#define PIDHASH 64
+static struct proc *pidhash[PIDHASH];
+static struct spinlock pid_lock;
+
+static void pidhash_insert(struct proc *p)
+{
+    acquire(&pid_lock);
+    p->pidnext = pidhash[p->pid % PIDHASH];
+    pidhash[p->pid % PIDHASH] = p;
+    release(&pid_lock);
+}
+
+static void pidhash_remove(struct proc *p)
+{
+    acquire(&pid_lock);
+    struct proc **pp = &pidhash[p->pid % PIDHASH];
+    while (*pp && *pp != p)
+        pp = &(*pp)->pidnext;
+    if (*pp)
+        *pp = p->pidnext;
+    p->pidnext = 0;
+    release(&pid_lock);
+}
+
+// 按 pid 查找进程，不持有其锁返回；调用者加锁后需复查 p->pid，槽位可能已被回收复用
+struct proc *findproc(int pid)
+{
+    if (pid <= 0)
+        return 0;
+    acquire(&pid_lock);
+    struct proc *p = pidhash[pid % PIDHASH];
+    while (p && p->pid != pid)
+        p = p->pidnext;
+    release(&pid_lock);
+    return p;
+}
+
+// 把 child 挂到 parent 的子进程链表上（parent 为 0 时没有父进程）
+void setparent(struct proc *child, struct proc *parent)
+{
+    acquire(&wait_lock);
+    child->parent = parent;
+    if (parent)
+    {
+        child->sibling = parent->children;
+        parent->children = child;
+    }
+    release(&wait_lock);
+}
+
+// 父进程退出时处理它的子进程：已是 ZOMBIE 的子进程不会再有人 wait，直接回收；
+// 其余子进程失去父进程，它们退出后由调度器回收
+void orphan_children(struct proc *p)
+{
+    acquire(&wait_lock);
+    struct proc *c = p->children;
+    while (c)
+    {
+        struct proc *next = c->sibling;
+        acquire(&c->lock);
+        if (c->state == ZOMBIE)
+        {
+            klog(LOG_LEVEL_INFO, "exit: pid=%d reaped orphan pid=%d", p->pid, c->pid);
+            freeproc(c);
+        }
+        else
+        {
+            c->parent = 0;
+            c->sibling = 0;
+        }
+        release(&c->lock);
+        c = next;
+    }
+    p->children = 0;
+    release(&wait_lock);
+}
+
+static int g_proc_ready = 0; // procinit 已完成，可以创建进程
 
 // 初始化进程系统
 void procinit(void)
 {
     initlock(&proc_lock, "proc_lock");
     initlock(&wait_lock, "wait_lock");
+    initlock(&pid_lock, "pid_lock");
+    memset(pidhash, 0, sizeof(pidhash));
+    futexinit();
+    shminit();
 
     for (int i = 0; i < NPROC; i++)
     {
@@ -58,9 +145,23 @@ void procinit(void)
         proc[i].sz = 0;
         proc[i].pid = 0;
         proc[i].parent = 0;
+        proc[i].children = 0;
+        proc[i].sibling = 0;
+        proc[i].pidnext = 0;
         proc[i].name[0] = 0;
         proc[i].killed = 0;
+        proc[i].shmmask = 0;
+        proc[i].fdmap = 0;
+        memset(proc[i].ofile, 0, sizeof(proc[i].ofile));
+        memset(proc[i].vma, 0, sizeof(proc[i].vma));
+        proc[i].mmaptop = 0;
     }
+    g_proc_ready = 1;
+}
+
+int proc_ready(void)
+{
+    return g_proc_ready;
 }
 
 // 获取当前进程
@@ -108,6 +209,10 @@ found:
     // 分配进程ID
     static int nextpid = 1;
     p->pid = nextpid++;
+    pidhash_insert(p);
+    p->prio = 0;
+    p->nice = 0;
+    p->slice_used = 0;
 
     // 标记为已使用，防止被后续 allocproc 重复选中
     p->state = USED;
@@ -167,12 +272,17 @@ int fork(void)
     }
     np->sz = p->sz;
 
+    // 继承打开的文件
+    fdinherit(p, np);
+
     // 复制陷阱帧
     *(np->trapframe) = *(p->trapframe);
     np->trapframe->a0 = 0; // 子进程返回0
 
-    // 设置父进程
-    np->parent = p;
+    // 设置父进程，子进程继承优先级设置
+    setparent(np, p);
+    np->nice = p->nice;
+    np->prio = p->nice;
 
     // 复制进程名（没有 safestrcpy 时使用 strncpy 并确保 NUL 结尾）
     strncpy(np->name, p->name, sizeof(p->name));
@@ -199,6 +309,10 @@ void exit(int status)
         ;              // 在精简测试环境中允许退出；不要对 proc[1] 做硬性 panic
     // 不在此处释放内核栈或页表：资源应由父进程在 wait()/freeproc() 中回收。
     // 在调用 sched() 前必须持有 p->lock（sched() 要求如此）。
+    // 关闭打开的文件（可能睡眠，须在持有 p->lock 之前）
+    fdcloseall(p);
+    orphan_children(p);
+
     acquire(&p->lock);
 
     // 设置退出状态并标记为 ZOMBIE
@@ -208,9 +322,10 @@ void exit(int status)
     // 记录进程退出（WARN）
     klog(LOG_LEVEL_WARN, "exit: pid=%d status=%d", p->pid, status);
 
-    // 唤醒父进程让其可以在 wait() 中收集此子进程
+    // 唤醒父进程让其可以在 wait() 中收集此子进程；没有父进程时由调度器回收
     acquire(&wait_lock);
-    wakeup(p->parent);
+    if (p->parent)
+        wakeup(p->parent);
     release(&wait_lock);
 
     // 切换到其他进程（sched 要求 p->lock 被持有）
@@ -220,10 +335,10 @@ void exit(int status)
     panic("exit: sched returned");
 }
 
-// 等待子进程退出
+// 等待子进程退出：只检查自己的子进程链表
 int wait(uint64 addr)
 {
-    struct proc *pp;
+    struct proc *pp, **link;
     int havekids, pid;
     struct proc *p = myproc();
 
@@ -232,30 +347,28 @@ int wait(uint64 addr)
     for (;;)
     {
         havekids = 0;
-        for (pp = proc; pp < &proc[NPROC]; pp++)
+        for (link = &p->children; (pp = *link) != 0; link = &pp->sibling)
         {
-            if (pp->parent == p)
+            acquire(&pp->lock);
+            if (pp->state == ZOMBIE)
             {
-                acquire(&pp->lock);
-                if (pp->state == ZOMBIE)
+                pid = pp->pid;
+                if (addr != 0 && copyout_user(p->pagetable, addr, (char *)&pp->xstate, sizeof(pp->xstate)) < 0)
                 {
-                    pid = pp->pid;
-                    if (addr != 0 && copyout_user(p->pagetable, addr, (char *)&pp->xstate, sizeof(pp->xstate)) < 0)
-                    {
-                        release(&pp->lock);
-                        release(&wait_lock);
-                        return -1;
-                    }
-                    // 记录 wait 收集子进程（INFO）
-                    klog(LOG_LEVEL_INFO, "wait: parent pid=%d collected child pid=%d status=%d", p->pid, pp->pid, pp->xstate);
-                    freeproc(pp);
                     release(&pp->lock);
                     release(&wait_lock);
-                    return pid;
+                    return -1;
                 }
+                // 记录 wait 收集子进程（INFO）
+                klog(LOG_LEVEL_INFO, "wait: parent pid=%d collected child pid=%d status=%d", p->pid, pp->pid, pp->xstate);
+                *link = pp->sibling;
+                freeproc(pp);
                 release(&pp->lock);
-                havekids = 1;
+                release(&wait_lock);
+                return pid;
             }
+            release(&pp->lock);
+            havekids = 1;
         }
 
         if (!havekids || p->killed)
@@ -268,30 +381,26 @@ int wait(uint64 addr)
     }
 }
 
-// 杀死进程
+// 杀死进程：经 pid 哈希表直接找到目标
 int kill(int pid)
 {
-    struct proc *p;
+    struct proc *p = findproc(pid);
+    if (p == 0)
+        return -1;
 
-    acquire(&proc_lock);
-    for (p = proc; p < &proc[NPROC]; p++)
+    acquire(&p->lock);
+    if (p->pid != pid)
     {
-        acquire(&p->lock);
-        if (p->pid == pid)
-        {
-            p->killed = 1;
-            if (p->state == SLEEPING)
-            {
-                p->state = RUNNABLE;
-            }
-            release(&p->lock);
-            release(&proc_lock);
-            return 0;
-        }
         release(&p->lock);
+        return -1;
     }
-    release(&proc_lock);
-    return -1;
+    p->killed = 1;
+    if (p->state == SLEEPING)
+    {
+        p->state = RUNNABLE;
+    }
+    release(&p->lock);
+    return 0;
 }
 
 // 释放进程资源
@@ -301,13 +410,23 @@ void freeproc(struct proc *p)
     // and must not be freed separately. Only free the page table if present.
     p->trapframe = 0;
 
+    // 共享内存段映射在 sz 之外，需单独分离
+    if (p->shmmask)
+        shm_detach_all(p);
+    if (p->pagetable)
+        mmap_release(p);
+
     if (p->pagetable)
         proc_freepagetable(p->pagetable, p->sz);
 
     p->pagetable = 0;
     p->sz = 0;
+    if (p->pid)
+        pidhash_remove(p);
     p->pid = 0;
     p->parent = 0;
+    p->children = 0;
+    p->sibling = 0;
     p->name[0] = 0;
     p->killed = 0;
     p->xstate = 0;
@@ -317,17 +436,8 @@ void freeproc(struct proc *p)
 // 释放进程页表以及用户内存页（如果有）
 void proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
-    // 遍历用户虚拟地址空间，释放所有叶子页并清除映射
-    for (uint64 a = 0; a < sz; a += PGSIZE)
-    {
-        pte_t *pte = walk_lookup(pagetable, a);
-        if (pte && (*pte & PTE_V))
-        {
-            uint64 pa = PTE2PA(*pte);
-            *pte = 0;
-            free_page((void *)pa);
-        }
-    }
+    // 批量释放用户虚拟地址空间中的所有叶子页并清除映射
+    unmap_range(pagetable, 0, PGROUNDUP(sz) / PGSIZE, 1);
 
     // 释放页表结构本身
     destroy_pagetable(pagetable);
@@ -351,6 +461,22 @@ void sleep(void *chan, struct spinlock *lk)
     acquire(lk);
 }
 
+// 睡眠到 get_time() 达到 when：不依赖时钟中断，由调度器在每次调度时检查到期
+void sleep_until(uint64 when)
+{
+    struct proc *p = myproc();
+
+    acquire(&p->lock);
+    p->wakeat = when;
+    p->chan = &p->wakeat;
+    p->state = SLEEPING;
+
+    sched();
+
+    p->chan = 0;
+    release(&p->lock);
+}
+
 // 唤醒进程
 void wakeup(void *chan)
 {
@@ -399,6 +525,13 @@ void sched(void)
     swtch(&p->context, &cpu.context);
 }
 
+// 持有一个自旋锁时能否在其上 sleep：有进程上下文、只持有这一个锁，且加锁前中断是开的。
+// 启动阶段的内核测试在关中断下运行，此时只能放锁轮询设备。
+int cansleep(void)
+{
+    return myproc() != 0 && cpu.noff == 1 && cpu.intena;
+}
+
 // fork返回，切换到用户空间
 void forkret(void)
 {
@@ -408,10 +541,81 @@ void forkret(void)
     usertrapret();
 }
 
+// 多级反馈队列（MLFQ）调度：进程从 nice 对应的级别开始，在某一级累计用满该级的时间额度
+// （MLFQ_QUANTUM << 级别 个定时器 tick）后降一级并让出 CPU；未用满额度的 tick 不会触发让出。
+// 每隔 MLFQ_BOOST 个 tick 把所有进程提升回各自的 nice 级别，避免低优先级进程饿死。
+// 调度器总是选择最高级别的可运行进程，同级之间轮转。
+// 经常睡眠的交互式进程用不满额度，因此保持在高优先级；计算密集的进程很快降到最低级。
+// sched_mlfq 为 0 时忽略级别，退化为按进程表顺序的轮转。
+int sched_mlfq = 1;
+static int rr_next;       // 轮转的起始位置
+static uint64 last_boost; // 上一次提升时的 ticks
+extern uint64 ticks;
+
+// 调用者持有 proc_lock；单 CPU 且已关中断，只读各进程的状态与级别时无需再取 p->lock
+static struct proc *sched_pick(uint64 now)
+{
+    struct proc *best = 0;
+    for (int k = 0; k < NPROC; k++)
+    {
+        struct proc *p = &proc[(rr_next + k) % NPROC];
+        // sleep_until 到期
+        if (p->state == SLEEPING && p->chan == &p->wakeat && now >= p->wakeat)
+        {
+            acquire(&p->lock);
+            if (p->state == SLEEPING && p->chan == &p->wakeat)
+                p->state = RUNNABLE;
+            release(&p->lock);
+        }
+        if (p->state != RUNNABLE)
+            continue;
+        if (best == 0 || (sched_mlfq && p->prio < best->prio))
+            best = p;
+    }
+    if (best)
+        rr_next = (best - proc) + 1;
+    return best;
+}
+
+// 定期提升：所有进程回到 nice 级别并清零已用额度，调用者持有 proc_lock
+static void sched_boost(void)
+{
+    uint64 now = ticks;
+    if (now - last_boost < MLFQ_BOOST)
+        return;
+    last_boost = now;
+    for (struct proc *p = proc; p < &proc[NPROC]; p++)
+    {
+        if (p->state != UNUSED)
+        {
+            p->prio = p->nice;
+            p->slice_used = 0;
+        }
+    }
+}
+
+// 定时器中断中调用：当前进程记入一个 tick，用满本级额度则降级。
+// 返回非零表示应当让出 CPU；轮转模式下每个 tick 都让出
+int sched_tick(void)
+{
+    struct proc *p = myproc();
+    if (p == 0)
+        return 0;
+    acquire(&p->lock);
+    int expired = ++p->slice_used >= ((uint64)MLFQ_QUANTUM << p->prio);
+    if (expired)
+    {
+        if (p->prio < NMLFQ - 1)
+            p->prio++;
+        p->slice_used = 0;
+    }
+    release(&p->lock);
+    return expired || !sched_mlfq;
+}
+
 // 调度器
 void scheduler(void)
 {
-    struct proc *p;
     struct cpu *c = &cpu;
 
     c->proc = 0;
@@ -420,25 +624,55 @@ void scheduler(void)
         intr_on();
 
         acquire(&proc_lock);
-        for (p = proc; p < &proc[NPROC]; p++)
+        sched_boost();
+        struct proc *p = sched_pick(get_time());
+        if (p == 0)
         {
-            acquire(&p->lock);
-            if (p->state == RUNNABLE)
-            {
-                p->state = RUNNING;
-                c->proc = p;
-                release(&proc_lock);
-                swtch(&c->context, &p->context);
-                // re-acquire proc_lock after coming back from the process
-                acquire(&proc_lock);
-                c->proc = 0;
-            }
-            release(&p->lock);
+            release(&proc_lock);
+            continue;
         }
+        acquire(&p->lock);
+        p->state = RUNNING;
+        c->proc = p;
+        g_nswitch++;
         release(&proc_lock);
+        swtch(&c->context, &p->context);
+        c->proc = 0;
+        // 没有父进程的进程退出后无人 wait，切换走之后在这里回收。
+        // 单 CPU 且已关中断，parent 只会在父进程运行时被修改，读取无需再取 wait_lock
+        if (p->state == ZOMBIE && p->parent == 0)
+            freeproc(p);
+        release(&p->lock);
     }
 }
 
+// 设置进程的 nice 级别（0 最高，NMLFQ-1 最低），pid 为 0 表示当前进程；
+// 进程立即移到该级别，此后每次提升都回到该级别
+int setpriority(int pid, int nice)
+{
+    if (nice < 0 || nice >= NMLFQ)
+        return -1;
+    struct proc *p = pid == 0 ? myproc() : findproc(pid);
+    if (p == 0)
+        return -1;
+    acquire(&p->lock);
+    if (pid != 0 && p->pid != pid)
+    {
+        release(&p->lock);
+        return -1;
+    }
+    p->nice = nice;
+    p->prio = nice;
+    p->slice_used = 0;
+    release(&p->lock);
+    return 0;
+}
+
+int sched_switches(void)
+{
+    return g_nswitch;
+}
+
 // 调试：打印进程表中所有非 UNUSED 条目，包含可读状态名
 void debug_proc(void)
 {
@@ -463,7 +697,7 @@ void debug_proc(void)
             const char *s = "?";
             if (p->state >= UNUSED && p->state <= ZOMBIE)
                 s = state_names[p->state];
-            printf("PID:%d State:%s Name:%s\n", p->pid, s, p->name);
+            printf("PID:%d State:%s Prio:%d Name:%s\n", p->pid, s, p->prio, p->name);
         }
         release(&p->lock);
     }
@@ -2,6 +2,8 @@
 #define _PROC_H_
 #include "vm.h"
 #include "spinlock.h"
+#include "param.h"
+#include "mmap.h"
 // Saved registers for kernel context switches.
 struct context
 {
@@ -107,9 +109,17 @@ struct proc
     int killed;           // If non-zero, have been killed
     int xstate;           // Exit status to be returned to parent's wait
     int pid;              // Process ID
+    int prio;             // MLFQ level, 0 = highest
+    int nice;             // Level restored by a priority boost (setpriority)
+    uint64 slice_used;    // Timer ticks used at the current level
+    uint64 wakeat;        // sleep_until deadline (cycles)
 
-    // wait_lock must be held when using this:
-    struct proc *parent; // Parent process
+    // wait_lock must be held when using these:
+    struct proc *parent;   // Parent process
+    struct proc *children; // First child (linked through sibling)
+    struct proc *sibling;  // Next child of the same parent
+
+    struct proc *pidnext; // pid hash chain (pid_lock)
 
     // these are private to the process, so p->lock need not be held.
     uint64 kstack;               // Virtual address of kernel stack
@@ -117,7 +127,11 @@ struct proc
     pagetable_t pagetable;       // User page table
     struct trapframe *trapframe; // data page for trampoline.S
     struct context context;      // swtch() here to run process
-    // struct file *ofile[NOFILE];  // Open files
+    struct file *ofile[NOFILE]; // Open files
+    uint fdmap;        // Allocated fds (bit i = fd i); lowest free fd = first zero bit
+    uint shmmask;      // Attached shared memory segments (bit i = id i, shm.c)
+    struct vma vma[NVMA]; // File mappings (mmap.c)
+    uint64 mmaptop;    // Next free address for mmap, from MMAPBASE
     struct inode *cwd; // Current directory
     char name[16];     // Process name (debugging)
 };
@@ -131,12 +145,20 @@ void exit(int);
 int wait(uint64);
 int kill(int);
 void setproc(struct proc *);
+struct proc *findproc(int pid);
+int proc_ready(void);
+void setparent(struct proc *child, struct proc *parent);
+void orphan_children(struct proc *p);
 
 // 调度相关函数
 void scheduler(void) __attribute__((noreturn));
 void yield(void);
 void sleep(void *, struct spinlock *);
+void sleep_until(uint64 when);
 void wakeup(void *);
+int setpriority(int pid, int nice);
+int sched_tick(void);
+extern int sched_mlfq;
 
 // Debug helper: print process table
 void debug_proc(void);
@@ -58,7 +58,7 @@ int create_process(void (*entry)(void))
     // Store the entry function pointer into trapframe->a0 so trampoline can read it.
     p->trapframe->a0 = (uint64)entry;
     // Set the parent to the current process so wait/wait_process can observe children
-    p->parent = myproc();
+    setparent(p, myproc());
     // Give the kernel thread a name of form "proc<pid>" (e.g. proc1)
     {
         char buf[16];
@@ -165,6 +165,15 @@ w_sepc(uint64 x)
     asm volatile("csrw sepc, %0" : : "r"(x));
 }
 
+// Supervisor Trap Value（缺页时为出错的虚拟地址）
+static inline uint64
+r_stval(void)
+{
+    uint64 x;
+    asm volatile("csrr %0, stval" : "=r"(x));
+    return x;
+}
+
 static inline uint64
 r_mip(void)
 {
@@ -0,0 +1,197 @@
+// kernel/shm.c
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "printf.h"
+#include "log.h"
+
+// 命名共享内存段：一组物理页被多个进程页表直接映射，进程间交换数据无需内核拷贝。
+// 段本身持有每个物理页的一个引用，每个挂载的进程再各持有一个引用，
+// 因此删除段与进程退出的先后顺序无关，最后一个引用释放时页面才回收。
+struct shmseg
+{
+    char name[16];
+    int used;                    // 槽位是否被占用
+    int removed;                 // 已 shm_unlink，等待最后一个进程分离
+    int npages;                  // 段大小（页）
+    int nattach;                 // 当前挂载的进程数
+    uint64 pages[SHM_MAXPAGES];  // 物理页地址
+};
+
+static struct shmseg shmsegs[NSHM];
+static struct spinlock shm_lock;
+
+void shminit(void)
+{
+    initlock(&shm_lock, "shm");
+    for (int i = 0; i < NSHM; i++)
+    {
+        shmsegs[i].used = 0;
+        shmsegs[i].removed = 0;
+        shmsegs[i].nattach = 0;
+    }
+}
+
+// 释放段自身持有的物理页引用并回收槽位，调用者持有 shm_lock
+static void shm_freeseg(struct shmseg *s)
+{
+    for (int i = 0; i < s->npages; i++)
+        free_page((void *)s->pages[i]);
+    s->npages = 0;
+    s->used = 0;
+    s->removed = 0;
+    s->name[0] = 0;
+}
+
+// 按名字查找共享内存段，不存在时创建 npages 页的新段
+// 返回段 id，失败返回 -1
+int shm_open(const char *name, int npages)
+{
+    struct shmseg *s, *freeslot = 0;
+
+    if (name == 0 || name[0] == 0)
+        return -1;
+
+    acquire(&shm_lock);
+    for (s = shmsegs; s < &shmsegs[NSHM]; s++)
+    {
+        if (s->used && !s->removed && strncmp(s->name, name, sizeof(s->name)) == 0)
+        {
+            release(&shm_lock);
+            return s - shmsegs;
+        }
+        if (!s->used && freeslot == 0)
+            freeslot = s;
+    }
+
+    if (freeslot == 0 || npages <= 0 || npages > SHM_MAXPAGES)
+    {
+        release(&shm_lock);
+        klog(LOG_LEVEL_WARN, "shm_open: cannot create '%s' npages=%d", name, npages);
+        return -1;
+    }
+
+    s = freeslot;
+    s->npages = 0;
+    for (int i = 0; i < npages; i++)
+    {
+        void *pa = alloc_page();
+        if (pa == 0)
+        {
+            shm_freeseg(s);
+            release(&shm_lock);
+            klog(LOG_LEVEL_WARN, "shm_open: out of memory for '%s'", name);
+            return -1;
+        }
+        memset(pa, 0, PGSIZE);
+        s->pages[s->npages++] = (uint64)pa;
+    }
+    strncpy(s->name, name, sizeof(s->name));
+    s->name[sizeof(s->name) - 1] = '\0';
+    s->used = 1;
+    s->removed = 0;
+    s->nattach = 0;
+    release(&shm_lock);
+
+    klog(LOG_LEVEL_INFO, "shm_open: created '%s' id=%d npages=%d", name, (int)(s - shmsegs), npages);
+    return s - shmsegs;
+}
+
+// 将段 id 映射到进程 p 的 SHMVA(id) 窗口，返回映射的虚拟地址，失败返回 0
+uint64 shm_attach(struct proc *p, int id)
+{
+    if (id < 0 || id >= NSHM || p == 0 || p->pagetable == 0)
+        return 0;
+
+    acquire(&shm_lock);
+    struct shmseg *s = &shmsegs[id];
+    if (!s->used || s->removed || (p->shmmask & (1U << id)))
+    {
+        release(&shm_lock);
+        return 0;
+    }
+
+    uint64 va = SHMVA(id);
+    for (int i = 0; i < s->npages; i++)
+    {
+        if (map_page(p->pagetable, va + i * PGSIZE, s->pages[i], PTE_R | PTE_W | PTE_U) < 0)
+        {
+            // 回滚已建立的映射（释放本次获取的引用）
+            unmap_range(p->pagetable, va, i, 1);
+            release(&shm_lock);
+            return 0;
+        }
+        page_ref_inc((void *)s->pages[i]);
+    }
+    s->nattach++;
+    p->shmmask |= (1U << id);
+    release(&shm_lock);
+
+    return va;
+}
+
+// 从进程 p 的页表中移除段 id 的映射，返回 0 成功，-1 失败
+int shm_detach(struct proc *p, int id)
+{
+    if (id < 0 || id >= NSHM || p == 0)
+        return -1;
+
+    acquire(&shm_lock);
+    struct shmseg *s = &shmsegs[id];
+    if (!(p->shmmask & (1U << id)))
+    {
+        release(&shm_lock);
+        return -1;
+    }
+
+    // do_free=1：归还本进程对这些物理页持有的引用
+    unmap_range(p->pagetable, SHMVA(id), s->npages, 1);
+    p->shmmask &= ~(1U << id);
+    s->nattach--;
+    if (s->removed && s->nattach == 0)
+        shm_freeseg(s);
+    release(&shm_lock);
+    return 0;
+}
+
+// 进程退出时分离所有已挂载的段
+void shm_detach_all(struct proc *p)
+{
+    for (int id = 0; id < NSHM && p->shmmask; id++)
+    {
+        if (p->shmmask & (1U << id))
+            shm_detach(p, id);
+    }
+}
+
+// 删除段：名字立即失效，物理页在最后一个进程分离后回收
+int shm_unlink(int id)
+{
+    if (id < 0 || id >= NSHM)
+        return -1;
+
+    acquire(&shm_lock);
+    struct shmseg *s = &shmsegs[id];
+    if (!s->used || s->removed)
+    {
+        release(&shm_lock);
+        return -1;
+    }
+    s->removed = 1;
+    if (s->nattach == 0)
+        shm_freeseg(s);
+    release(&shm_lock);
+    return 0;
+}
+
+// 段大小（页），无效 id 返回 0
+int shm_npages(int id)
+{
+    if (id < 0 || id >= NSHM || !shmsegs[id].used)
+        return 0;
+    return shmsegs[id].npages;
+}
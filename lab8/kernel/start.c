@@ -10,7 +10,12 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "fs.h"
+#include "file.h"
+#include "virtio.h"
+#include "iosched.h"
 #include "log.h"
+#include "fcntl.h"
+#include "futex.h"
 
 extern char _bss_start[], _bss_end[];
 
@@ -90,6 +95,33 @@ void test_pagetable(void)
     printf("test success!");
 }
 
+// 批量映射测试：1MiB 区域只需一次 walk，并用 unmap_range 整体取消映射
+void test_pagetable_range(void)
+{
+    pmem_init();
+    pagetable_t pt = create_pagetable();
+    uint64 va = 0x1000000; // 2MiB 对齐，256 页落在同一个 level-0 页表
+    uint64 npages = (1024 * 1024) / PGSIZE;
+    uint64 pa = KERNBASE + 64 * 1024 * 1024; // 只建立映射，不访问该物理区域
+
+    uint64 walks_before = vm_walk_count();
+    assert(mappages(pt, va, npages * PGSIZE, pa, PTE_R | PTE_W) == 0);
+    uint64 walks = vm_walk_count() - walks_before;
+    printf("mappages 1MiB: %d pages, %d walks\n", (int)npages, (int)walks);
+    assert(walks == 1);
+
+    // 首尾页的地址转换
+    assert(walkaddr(pt, va) == pa);
+    assert(walkaddr(pt, va + (npages - 1) * PGSIZE) == pa + (npages - 1) * PGSIZE);
+
+    walks_before = vm_walk_count();
+    unmap_range(pt, va, npages, 0);
+    printf("unmap_range 1MiB: %d walks\n", (int)(vm_walk_count() - walks_before));
+    assert(walkaddr(pt, va) == 0);
+    destroy_pagetable(pt);
+    printf("test_pagetable_range passed\n");
+}
+
 void test_virtual_memory(void)
 {
     printf("Before enabling paging...\n");
@@ -412,6 +444,52 @@ void test_scheduler(void)
     printf("test_scheduler: scheduler returned (unexpected)\n");
 }
 
+// 调度延迟基准：若干计算密集型进程运行时，watcher 反复用 sleep_until 定时睡眠，
+// 记录从到期到真正被调度运行的延迟。mlfq 为 0 时使用轮转调度作对比
+#define LAT_NHOGS 3
+#define LAT_WAKES 50
+#define LAT_PERIOD 200000 // 约 20ms
+
+void latency_watcher(void)
+{
+    uint64 total = 0, worst = 0;
+    for (int i = 0; i < LAT_WAKES; i++)
+    {
+        uint64 deadline = get_time() + LAT_PERIOD;
+        sleep_until(deadline);
+        uint64 lat = get_time() - deadline;
+        total += lat;
+        if (lat > worst)
+            worst = lat;
+    }
+    printf("sched latency (%s, %d hogs): avg=%d max=%d cycles over %d wakeups, prio=%d\n",
+           sched_mlfq ? "mlfq" : "rr", LAT_NHOGS, (int)(total / LAT_WAKES), (int)worst, LAT_WAKES,
+           myproc()->prio);
+}
+
+void test_sched_latency(int mlfq)
+{
+    printf("Testing scheduler wakeup latency...\n");
+    pmem_init();
+    procinit();
+    sched_mlfq = mlfq;
+
+    int pid = 0;
+    for (int i = 0; i < LAT_NHOGS; i++)
+    {
+        pid = create_process(cpu_intensive_task);
+        assert(pid > 0);
+    }
+    // setpriority 参数检查：级别越界、pid 不存在
+    assert(setpriority(pid, NMLFQ) == -1);
+    assert(setpriority(12345, 0) == -1);
+    assert(setpriority(pid, 0) == 0 && findproc(pid)->prio == 0);
+
+    assert(create_process(latency_watcher) > 0);
+    // scheduler() 不会返回，结果由 watcher 打印
+    scheduler();
+}
+
 void debug_proc_table(void)
 {
     pmem_init();
@@ -471,6 +549,266 @@ void test_syscall(void)
     setproc(old);
 }
 
+// 以当前进程身份发起一次系统调用，返回 a0
+static int do_syscall(struct trapframe *tf, int num, uint64 a0, uint64 a1, uint64 a2, uint64 a3)
+{
+    tf->a7 = num;
+    tf->a0 = a0;
+    tf->a1 = a1;
+    tf->a2 = a2;
+    tf->a3 = a3;
+    syscall();
+    return (int)tf->a0;
+}
+
+// 文件描述符系统调用：最小空闲 fd、dup 共享偏移、pread、readv/writev、sendfile 与管道
+void test_fd_syscalls(void)
+{
+    printf("Testing file descriptor syscalls...\n");
+    consoleinit();
+    pmem_init();
+    kvminit();
+    procinit();
+    fs_init();
+    fileinit();
+
+    struct trapframe tf;
+    static struct proc fakep;
+    memset(&tf, 0, sizeof(tf));
+    memset(&fakep, 0, sizeof(fakep));
+    fakep.trapframe = &tf;
+    // 内核页表恒等映射，内核地址可以直接当作用户地址
+    extern pagetable_t kernel_pagetable;
+    fakep.pagetable = kernel_pagetable;
+    fakep.pid = 1;
+    struct proc *old = myproc();
+    setproc(&fakep);
+
+    static char path[] = "/fdtest";
+    int fd = do_syscall(&tf, SYS_open, (uint64)path, O_CREATE | O_RDWR, 0, 0);
+    assert(fd == 0);
+    static char rec[] = "0123456789";
+    assert(do_syscall(&tf, SYS_write, fd, (uint64)rec, 10, 0) == 10);
+
+    // dup 得到最小空闲 fd，与原 fd 共享偏移
+    int fd2 = do_syscall(&tf, SYS_dup, fd, 0, 0, 0);
+    assert(fd2 == 1);
+    assert(do_syscall(&tf, SYS_write, fd2, (uint64)rec, 5, 0) == 5);
+    assert(fdget(&fakep, fd)->off == 15);
+
+    // 关闭 fd 0 后再次打开会复用它；新 file 的偏移从 0 开始
+    assert(do_syscall(&tf, SYS_close, fd, 0, 0, 0) == 0);
+    assert(do_syscall(&tf, SYS_close, fd, 0, 0, 0) == -1);
+    fd = do_syscall(&tf, SYS_open, (uint64)path, O_RDONLY, 0, 0);
+    assert(fd == 0);
+    static char buf[32];
+    assert(do_syscall(&tf, SYS_pread, fd, (uint64)buf, 4, 10) == 4);
+    assert(memcmp(buf, "0123", 4) == 0);
+    assert(do_syscall(&tf, SYS_read, fd, (uint64)buf, 32, 0) == 15);
+    assert(do_syscall(&tf, SYS_write, fd, (uint64)rec, 1, 0) == -1); // 只读
+
+    // writev 一次写入两段，readv 分段读回
+    static struct iovec iov[2];
+    static char a[3], b[4];
+    iov[0].iov_base = rec;
+    iov[0].iov_len = 3;
+    iov[1].iov_base = rec + 6;
+    iov[1].iov_len = 4;
+    assert(do_syscall(&tf, SYS_writev, fd2, (uint64)iov, 2, 0) == 7);
+    iov[0].iov_base = a;
+    iov[1].iov_base = b;
+    assert(do_syscall(&tf, SYS_readv, fd, (uint64)iov, 2, 0) == 7);
+    assert(memcmp(a, "012", 3) == 0 && memcmp(b, "6789", 4) == 0);
+
+    // sendfile：文件增长到超出内联大小后，从 fd 的当前偏移整个发送到另一个文件，
+    // 再发送一段到控制台（fd 2 未打开）
+    for (int i = 0; i < 10; i++)
+        assert(do_syscall(&tf, SYS_write, fd2, (uint64)rec, 10, 0) == 10);
+    assert(do_syscall(&tf, SYS_close, fd2, 0, 0, 0) == 0);
+    static char path2[] = "/fdcopy";
+    int out = do_syscall(&tf, SYS_open, (uint64)path2, O_CREATE | O_WRONLY, 0, 0);
+    assert(out == 1);
+    fdget(&fakep, fd)->off = 0;
+    assert(do_syscall(&tf, SYS_sendfile, out, fd, (uint64)-1, 200) == 122);
+    assert(fdget(&fakep, fd)->off == 122);
+    assert(do_syscall(&tf, SYS_sendfile, 2, fd, 0, 10) == 10);
+    printf("\n");
+    struct inode *cp = namei(path2);
+    assert(cp != 0 && cp->size == 122);
+    assert(readi(cp, buf, 15, 7) == 7 && memcmp(buf, "0126789", 7) == 0);
+    assert(readi(cp, buf, 112, 10) == 10 && memcmp(buf, rec, 10) == 0);
+    iput(cp);
+
+    // 管道：数据按序读出，sendfile 把页缓存页直接送进管道，管道不支持 pread，
+    // 关闭写端后读到 EOF
+    static int pfd[2];
+    assert(do_syscall(&tf, SYS_pipe, (uint64)pfd, 0, 0, 0) == 0);
+    assert(pfd[0] == 2 && pfd[1] == 3);
+    assert(do_syscall(&tf, SYS_write, pfd[1], (uint64)rec, 4, 0) == 4);
+    assert(do_syscall(&tf, SYS_sendfile, pfd[1], fd, 112, 10) == 10);
+    assert(do_syscall(&tf, SYS_read, pfd[0], (uint64)buf, 32, 0) == 14);
+    assert(memcmp(buf, "0123", 4) == 0 && memcmp(buf + 4, rec, 10) == 0);
+    assert(do_syscall(&tf, SYS_pread, pfd[0], (uint64)buf, 1, 0) == -1);
+    assert(do_syscall(&tf, SYS_close, pfd[1], 0, 0, 0) == 0);
+    assert(do_syscall(&tf, SYS_read, pfd[0], (uint64)buf, 32, 0) == 0);
+
+    fdcloseall(&fakep);
+    assert(fakep.fdmap == 0);
+    struct inode *root = namei("/");
+    assert(dirunlink(root, "fdcopy") == 0);
+    assert(dirunlink(root, "fdtest") == 0);
+    iput(root);
+    setproc(old);
+    printf("test_fd_syscalls passed\n");
+}
+
+// 管道吞吐量：生产者与消费者两个进程经一个管道传输 PIPEBENCH_BYTES 字节，
+// 消费者校验数据并报告 KB/s 以及跨越环空/满边界的唤醒次数
+#define PIPEBENCH_BYTES (4 * 1024 * 1024)
+#define PIPEBENCH_CHUNK 1024
+static struct file *pipebench_rf, *pipebench_wf;
+static uint64 pipebench_start;
+
+void pipebench_producer(void)
+{
+    static char chunk[PIPEBENCH_CHUNK];
+    for (int i = 0; i < PIPEBENCH_BYTES; i += PIPEBENCH_CHUNK)
+    {
+        for (int j = 0; j < PIPEBENCH_CHUNK; j++)
+            chunk[j] = (char)((i + j) * 7);
+        if (filewrite(pipebench_wf, chunk, PIPEBENCH_CHUNK) != PIPEBENCH_CHUNK)
+            panic("pipebench_producer: short write");
+    }
+    fileclose(pipebench_wf);
+}
+
+void pipebench_consumer(void)
+{
+    static char chunk[PIPEBENCH_CHUNK];
+    int tot = 0, r;
+    while ((r = fileread(pipebench_rf, chunk, sizeof(chunk))) > 0)
+    {
+        for (int j = 0; j < r; j++)
+            assert(chunk[j] == (char)((tot + j) * 7));
+        tot += r;
+    }
+    uint64 cycles = get_time() - pipebench_start;
+    fileclose(pipebench_rf);
+    assert(tot == PIPEBENCH_BYTES);
+    // qemu virt 时钟 10MHz：KB/s = KB * 10^7 / cycles
+    printf("Pipe (%dKB in %dB writes): %d cycles (%d KB/s), wakeups=%d\n", tot / 1024, PIPEBENCH_CHUNK,
+           (int)cycles, cycles ? (int)((uint64)tot / 1024 * 10000000 / cycles) : 0, pipe_wakeups());
+}
+
+void test_pipe_throughput(void)
+{
+    printf("Testing pipe throughput...\n");
+    pmem_init();
+    procinit();
+    fileinit();
+    assert(pipealloc(&pipebench_rf, &pipebench_wf) == 0);
+
+    // 内核中的 fork() 只能返回用户态，生产者与消费者以内核进程运行，各自只使用管道的一端
+    assert(create_process(pipebench_producer) > 0);
+    assert(create_process(pipebench_consumer) > 0);
+    pipebench_start = get_time();
+    // scheduler() 不会返回，结果由消费者打印
+    scheduler();
+}
+
+// futex 互斥锁（0 空闲，1 持有，2 持有且可能有等待者）：无竞争时加锁与解锁都只是一条原子指令，
+// 只有竞争时才进入内核等待与唤醒
+#define FUTEX_NWORKERS 4
+#define FUTEX_ITERS 2000
+static int futex_lockword;
+static int futex_counter;
+static int futex_workers_left;
+static int futex_slowpath; // 进入内核（FUTEX_WAIT/FUTEX_WAKE）的次数
+
+static void futex_mutex_lock(int *w)
+{
+    extern pagetable_t kernel_pagetable;
+    int c = __sync_val_compare_and_swap(w, 0, 1);
+    if (c == 0)
+        return;
+    if (c != 2)
+        c = __sync_lock_test_and_set(w, 2);
+    while (c != 0)
+    {
+        __sync_fetch_and_add(&futex_slowpath, 1);
+        futex_wait(kernel_pagetable, (uint64)w, 2);
+        c = __sync_lock_test_and_set(w, 2);
+    }
+}
+
+static void futex_mutex_unlock(int *w)
+{
+    extern pagetable_t kernel_pagetable;
+    if (__sync_fetch_and_sub(w, 1) != 1)
+    {
+        *(volatile int *)w = 0;
+        __sync_fetch_and_add(&futex_slowpath, 1);
+        futex_wake(kernel_pagetable, (uint64)w, 1);
+    }
+}
+
+void futex_worker(void)
+{
+    for (int i = 0; i < FUTEX_ITERS; i++)
+    {
+        futex_mutex_lock(&futex_lockword);
+        int v = futex_counter;
+        // 偶尔在临界区内让出 CPU，制造竞争
+        if (i % 64 == 0)
+            yield();
+        futex_counter = v + 1;
+        futex_mutex_unlock(&futex_lockword);
+    }
+    if (__sync_sub_and_fetch(&futex_workers_left, 1) == 0)
+    {
+        assert(futex_counter == FUTEX_NWORKERS * FUTEX_ITERS);
+        printf("futex mutex: %d acquisitions, %d kernel entries, %d kernel waits\n",
+               FUTEX_NWORKERS * FUTEX_ITERS, futex_slowpath, futex_wait_count());
+        printf("test_futex passed\n");
+    }
+}
+
+// futex 系统调用：值不匹配时不睡眠、地址检查，然后由多个进程竞争一个 futex 互斥锁
+void test_futex(void)
+{
+    printf("Testing futex...\n");
+    consoleinit();
+    pmem_init();
+    kvminit();
+    procinit();
+
+    struct trapframe tf;
+    static struct proc fakep;
+    memset(&tf, 0, sizeof(tf));
+    memset(&fakep, 0, sizeof(fakep));
+    fakep.trapframe = &tf;
+    extern pagetable_t kernel_pagetable;
+    fakep.pagetable = kernel_pagetable;
+    fakep.pid = 1;
+    struct proc *old = myproc();
+    setproc(&fakep);
+    static int word = 5;
+    assert(do_syscall(&tf, SYS_futex, (uint64)&word, FUTEX_WAIT, 4, 0) == -1);
+    assert(do_syscall(&tf, SYS_futex, (uint64)&word, FUTEX_WAKE, 1, 0) == 0);
+    assert(do_syscall(&tf, SYS_futex, (uint64)&word + 1, FUTEX_WAKE, 1, 0) == -1);
+    assert(do_syscall(&tf, SYS_futex, (uint64)&word, 7, 0, 0) == -1);
+    setproc(old);
+
+    futex_lockword = 0;
+    futex_counter = 0;
+    futex_slowpath = 0;
+    futex_workers_left = FUTEX_NWORKERS;
+    for (int i = 0; i < FUTEX_NWORKERS; i++)
+        assert(create_process(futex_worker) > 0);
+    // scheduler() 不会返回，结果由最后退出的工作进程打印
+    scheduler();
+}
+
 // 在内核中通过 syscall() 测试 fork/wait
 void test_syscall_fork(void)
 {
@@ -513,18 +851,9 @@ void test_syscall_fork(void)
         return;
     }
 
-    // 在 proc 表中找到子进程，并将其标记为 ZOMBIE（模拟子进程已退出）
-    extern struct proc proc[];
+    // 按 pid 找到子进程，并将其标记为 ZOMBIE（模拟子进程已退出）
     extern struct spinlock wait_lock;
-    struct proc *pp = 0;
-    for (int i = 0; i < NPROC; i++)
-    {
-        if (proc[i].pid == childpid)
-        {
-            pp = &proc[i];
-            break;
-        }
-    }
+    struct proc *pp = findproc(childpid);
     if (!pp)
     {
         printf("test_syscall_fork: child not found\n");
@@ -551,6 +880,65 @@ void test_syscall_fork(void)
     setproc(old);
 }
 
+// pid 哈希查找与子进程链表：kill 直接找到目标，wait 只回收自己的子进程
+void test_pid_lookup(void)
+{
+    printf("Testing pid lookup and children lists...\n");
+    pmem_init();
+    procinit();
+
+    struct proc *parent = allocproc();
+    assert(parent != 0);
+    release(&parent->lock);
+    struct proc *old = myproc();
+    setproc(parent);
+
+    int pids[3];
+    for (int i = 0; i < 3; i++)
+    {
+        pids[i] = create_process(simple_task);
+        assert(pids[i] > 0);
+        assert(findproc(pids[i]) != 0 && findproc(pids[i])->parent == parent);
+    }
+    // 与父进程无关的进程不在其子进程链表上
+    setproc(0);
+    int other = create_process(simple_task);
+    setproc(parent);
+    int nkids = 0;
+    for (struct proc *c = parent->children; c; c = c->sibling)
+        nkids++;
+    assert(nkids == 3);
+    assert(findproc(other)->parent == 0);
+
+    assert(kill(pids[1]) == 0 && findproc(pids[1])->killed);
+    assert(kill(12345) == -1);
+
+    // 模拟第一个子进程退出，wait 回收它后 pid 不再能查到
+    struct proc *c0 = findproc(pids[0]);
+    acquire(&c0->lock);
+    c0->state = ZOMBIE;
+    release(&c0->lock);
+    assert(wait(0) == pids[0]);
+    assert(findproc(pids[0]) == 0);
+    nkids = 0;
+    for (struct proc *c = parent->children; c; c = c->sibling)
+        nkids++;
+    assert(nkids == 2);
+
+    // 父进程退出：已退出的子进程直接回收，其余子进程不再有父进程
+    struct proc *c2 = findproc(pids[2]);
+    acquire(&c2->lock);
+    c2->state = ZOMBIE;
+    release(&c2->lock);
+    orphan_children(parent);
+    assert(findproc(pids[2]) == 0);
+    assert(findproc(pids[1]) != 0 && findproc(pids[1])->parent == 0);
+    assert(parent->children == 0);
+
+    setproc(old);
+    printf("test_pid_lookup passed\n");
+}
+
 void test_filesystem_integrity(void)
 {
     consoleinit();
@@ -560,7 +948,7 @@ void test_filesystem_integrity(void)
     fileinit();
 
     // 直接使用内核 inode 接口创建并测试读写
-    struct inode *ip = ialloc(0, 1); // type=1 (file/dir)
+    struct inode *ip = ialloc(0, T_FILE);
     assert(ip != 0);
 
     char wbuf[] = "Hello, filesystem!";
@@ -587,8 +975,8 @@ void test_filesystem_integrity(void)
         panic("filesystem contents mismatch");
     }
 
-    // 模拟删除：清除 inode 标记并释放引用
-    ip->valid = 0;
+    // 模拟删除：链接数清零，最后一个引用释放时回收
+    ip->nlink = 0;
     iput(ip);
 
     printf("Filesystem integrity test passed\n");
@@ -602,7 +990,7 @@ void concurrent_worker(void)
     printf("worker %d: started\n", pid);
     for (int j = 0; j < 100; j++)
     {
-        struct inode *ip = ialloc(0, 1);
+        struct inode *ip = ialloc(0, T_FILE);
         if (!ip)
         {
             // allocation failed, back off and continue
@@ -625,7 +1013,7 @@ void concurrent_worker(void)
             printf("worker %d: mismatch iter %d %d!=%d\n", pid, j, r, val);
         }
         // simulate unlink
-        ip->valid = 0;
+        ip->nlink = 0;
         iput(ip);
     }
     printf("worker %d: done\n", pid);
@@ -639,9 +1027,11 @@ void test_concurrent_access(void)
 
     pmem_init();
     procinit();
+    fs_init();
     // trap_init();
     // enable_interrupts();
 
+    // 日志检查点由 fs_init 启动的后台线程完成，写者提交后即返回
     const int nworkers = 4;
     for (int i = 0; i < nworkers; i++)
     {
@@ -676,6 +1066,8 @@ void debug_filesystem_state(void)
     // 缓存命中统计（读取器会在使用 bread 时变化）
     printf("Buffer cache hits: %d\n", buffer_cache_hits());
     printf("Buffer cache misses: %d\n", buffer_cache_misses());
+    printf("Page cache hits: %d\n", pcache_hits());
+    printf("Page cache misses: %d\n", pcache_misses());
 }
 // 新的测试函数：磁盘 I/O 统计打印
 void debug_disk_io(void)
@@ -701,7 +1093,7 @@ void new_debug_disk_io(void)
     struct buf *b = bread(0, sample);
     brelse(b);
     // 触发一次写（分配 inode 并写入一个整数）
-    struct inode *ip = ialloc(0, 1);
+    struct inode *ip = ialloc(0, T_FILE);
     if (ip)
     {
         int val = 42;
@@ -744,12 +1136,14 @@ void test_filesystem_performance(void)
     fileinit();
 
     // 大量小“文件”（inode）测试：每次分配一个 inode，写入 4 字节，再释放
+    // 4 字节内联在 inode 中，不分配数据块
+    int balloc0 = balloc_count();
     uint64 start_time = get_time();
     const int small_n = 1000;
     const char small_data[4] = {'t', 'e', 's', 't'};
     for (int i = 0; i < small_n; i++)
     {
-        struct inode *ip = ialloc(0, 1); // type=1：文件
+        struct inode *ip = ialloc(0, T_FILE);
         if (!ip)
         {
             // 分配失败则跳过，避免测试中断
@@ -759,36 +1153,810 @@ void test_filesystem_performance(void)
         int wrote = writei(ip, (char *)small_data, 0, sizeof(small_data));
         (void)wrote; // 测试场景不强制校验返回值
         // 释放并模拟“unlink”
-        ip->valid = 0;
+        ip->nlink = 0;
         iput(ip);
     }
     uint64 small_files_time = get_time() - start_time;
+    int small_ballocs = balloc_count() - balloc0;
 
-    // 大文件测试：同一个 inode 连续写入 4KB * 1024 = 4MB
-    start_time = get_time();
-    struct inode *large = ialloc(0, 1);
+    // 大文件测试：同一个 inode 连续写入 4KB * 2048 = 8MB（超出一级间接块的范围），
+    // 写回到磁盘后丢弃页缓存再顺序读回
+    const int large_pages = 2048;
+    uint64 large_write_time = 0, large_read_time = 0;
+    struct inode *large = ialloc(0, T_FILE);
     if (large)
     {
         char *large_buffer = (char *)alloc_page();
         if (large_buffer)
         {
             // 缓冲区内容无需特定值，保持未初始化即可
-            for (int i = 0; i < 1024; i++)
+            start_time = get_time();
+            for (int i = 0; i < large_pages; i++)
             {
                 // 每次写 4KB，偏移递增
                 writei(large, large_buffer, i * BSIZE, BSIZE);
             }
+            iflush(large);
+            large_write_time = get_time() - start_time;
+
+            pcache_drop(large);
+            start_time = get_time();
+            for (int i = 0; i < large_pages; i++)
+                readi(large, large_buffer, i * BSIZE, BSIZE);
+            large_read_time = get_time() - start_time;
             free_page(large_buffer);
         }
         // 释放并模拟“unlink”
-        large->valid = 0;
+        large->nlink = 0;
         iput(large);
     }
-    uint64 large_file_time = get_time() - start_time;
 
-    printf("Small files (1000x4B): %d cycles\n", (int)small_files_time);
-    printf("Large file (1x4MB): %d cycles\n", (int)large_file_time);
+    printf("Small files (1000x4B): %d cycles, block allocations=%d\n", (int)small_files_time, small_ballocs);
+    // qemu virt 时钟 10MHz：KB/s = KB * 10^7 / cycles
+    uint64 large_kb = (uint64)large_pages * BSIZE / 1024;
+    printf("Large file (1x8MB) write: %d cycles (%d KB/s)\n", (int)large_write_time,
+           large_write_time ? (int)(large_kb * 10000000 / large_write_time) : 0);
+    printf("Large file (1x8MB) read: %d cycles (%d KB/s), indirect cache hits=%d\n", (int)large_read_time,
+           large_read_time ? (int)(large_kb * 10000000 / large_read_time) : 0, indcache_hits());
+
+    struct iosched_stats st;
+    iosched_get_stats(&st);
+    printf("I/O scheduler %s: requests=%d merges=%d max_depth=%d expired=%d avg_latency=%d cycles\n",
+           iosched_name(), st.dispatched, st.merges, st.max_depth, st.expired,
+           st.completed ? (int)(st.total_lat / st.completed) : 0);
 }
+// mmap 测试：在内核中模拟缺页，验证只读映射零拷贝共享页缓存、私有映射写时复制
+void test_mmap_file(void)
+{
+    consoleinit();
+    printf("Testing file mmap...\n");
+    pmem_init();
+    procinit();
+    fs_init();
+
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char *buf = (char *)alloc_page();
+    for (int pg = 0; pg < 3; pg++)
+    {
+        memset(buf, 'a' + pg, PGSIZE);
+        assert(writei(ip, buf, pg * PGSIZE, PGSIZE) == PGSIZE);
+    }
+
+    struct proc *p1 = allocproc();
+    struct proc *p2 = allocproc();
+    assert(p1 && p2);
+    release(&p1->lock);
+    release(&p2->lock);
+    p1->pagetable = create_pagetable();
+    p2->pagetable = create_pagetable();
+
+    uint64 va1 = mmap_file(p1, ip, 0, 3 * PGSIZE, PROT_READ, MAP_SHARED);
+    uint64 va2 = mmap_file(p2, ip, PGSIZE, 2 * PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE);
+    assert(va1 != 0 && va2 != 0);
+
+    // 未访问前没有任何页表项
+    assert(walkaddr(p1->pagetable, va1) == 0);
+
+    // 读缺页：两个进程映射到同一个缓存物理页
+    for (int pg = 0; pg < 3; pg++)
+        assert(mmap_fault(p1, va1 + pg * PGSIZE, 0) == 0);
+    assert(mmap_fault(p2, va2, 0) == 0);
+    uint64 pa1 = walkaddr(p1->pagetable, va1 + PGSIZE);
+    uint64 pa2 = walkaddr(p2->pagetable, va2);
+    assert(pa1 == pa2);
+    assert(*(char *)pa1 == 'b');
+    assert(*(char *)walkaddr(p1->pagetable, va1 + 2 * PGSIZE) == 'c');
+
+    // 私有映射写缺页：复制出私有页，共享映射内容不变
+    assert(mmap_fault(p2, va2, 1) == 0);
+    uint64 priv = walkaddr(p2->pagetable, va2);
+    assert(priv != pa1);
+    *(char *)priv = 'X';
+    assert(*(char *)pa1 == 'b');
+
+    // 只读映射上的写访问应被拒绝
+    assert(mmap_fault(p1, va1, 1) < 0);
+
+    // futex 作用在尚未缺页的私有映射上：先复制出私有页，以私有页的物理地址为键，
+    // 之后进程写这个字不会再换页
+    uint64 va3 = va2 + PGSIZE;
+    assert(walkaddr(p2->pagetable, va3) == 0);
+    struct proc *old = myproc();
+    setproc(p2);
+    assert(futex_wake(p2->pagetable, va3, 1) == 0);
+    setproc(old);
+    uint64 fpa = walkaddr(p2->pagetable, va3);
+    assert(fpa != 0 && fpa != pcache_get(ip, 2));
+    assert(*(char *)fpa == 'c');
+    pte_t *fpte = walk_lookup(p2->pagetable, va3);
+    assert(fpte && (*fpte & PTE_W));
+
+    printf("page cache: hits=%d misses=%d\n", pcache_hits(), pcache_misses());
+
+    assert(munmap_file(p1, va1, 3 * PGSIZE) == 0);
+    assert(walkaddr(p1->pagetable, va1) == 0);
+    acquire(&p1->lock);
+    freeproc(p1);
+    release(&p1->lock);
+    acquire(&p2->lock);
+    freeproc(p2);
+    release(&p2->lock);
+    free_page(buf);
+    printf("test_mmap_file passed\n");
+}
+
+// 顺序预读测试：顺序读取应命中预读页，随机读取应关闭预读
+void test_readahead(void)
+{
+    consoleinit();
+    printf("Testing sequential readahead...\n");
+    pmem_init();
+    fs_init();
+    fileinit();
+
+    const int npages = 48;
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char *buf = (char *)alloc_page();
+    for (int pg = 0; pg < npages; pg++)
+    {
+        memset(buf, 'A' + (pg % 26), BSIZE);
+        assert(writei(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+    }
+    // 写回后丢弃缓存页，使读取从磁盘开始
+    iflush(ip);
+    pcache_drop(ip);
+
+    struct file *f = filealloc();
+    assert(f != 0);
+    f->type = FD_INODE;
+    f->ip = iget(0, ip->inum);
+    f->readable = 1;
+
+    int misses0 = pcache_misses();
+    uint64 start_time = get_time();
+    for (int pg = 0; pg < npages; pg++)
+    {
+        assert(fileread(f, buf, BSIZE) == BSIZE);
+        assert(buf[0] == 'A' + (pg % 26));
+    }
+    uint64 seq_time = get_time() - start_time;
+    printf("sequential: %d cycles, misses=%d ra_hits=%d ra_wasted=%d window=%d\n",
+           (int)seq_time, pcache_misses() - misses0, pcache_ra_hits(), pcache_ra_wasted(), (int)f->ra_window);
+
+    // 随机访问：窗口应被关闭
+    pcache_drop(ip);
+    int ra0 = pcache_ra_hits();
+    for (int i = 0; i < 8; i++)
+    {
+        f->off = ((i * 17) % npages) * BSIZE;
+        fileread(f, buf, BSIZE);
+        assert(f->ra_window == 0);
+    }
+    printf("random: ra_hits delta=%d\n", pcache_ra_hits() - ra0);
+
+    fileclose(f);
+    free_page(buf);
+    printf("test_readahead passed\n");
+}
+
+void test_virtio_disk(void)
+{
+    consoleinit();
+    printf("Testing virtio disk request queue...\n");
+    pmem_init();
+    binit();
+
+    // 一次提交多个请求，再统一等待完成；只用磁盘末尾的保留块，不碰文件系统
+    const int n = 8;
+    uint scratch = virtio_disk_nblocks() - SCRATCHBLOCKS;
+    struct vreq reqs[8];
+    char *pages[8];
+    for (int i = 0; i < n; i++)
+    {
+        pages[i] = (char *)alloc_page();
+        assert(pages[i] != 0);
+        memset(pages[i], 'a' + i, BSIZE);
+        reqs[i].blockno = scratch + i;
+        reqs[i].nseg = 1;
+        reqs[i].data[0] = pages[i];
+        reqs[i].write = 1;
+        reqs[i].callback = 0;
+        virtio_disk_submit(&reqs[i]);
+    }
+    for (int i = 0; i < n; i++)
+        virtio_disk_wait(&reqs[i]);
+
+    for (int i = 0; i < n; i++)
+    {
+        memset(pages[i], 0, BSIZE);
+        reqs[i].write = 0;
+        virtio_disk_submit(&reqs[i]);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        virtio_disk_wait(&reqs[i]);
+        assert(pages[i][0] == 'a' + i && pages[i][BSIZE - 1] == 'a' + i);
+        free_page(pages[i]);
+    }
+    printf("max in-flight requests: %d\n", virtio_disk_max_inflight());
+    printf("test_virtio_disk passed\n");
+}
+
+void test_log_group_commit(void)
+{
+    consoleinit();
+    printf("Testing log group commit...\n");
+    pmem_init();
+    fs_init();
+    fileinit();
+
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char *buf = (char *)alloc_page();
+    assert(buf != 0);
+    // 直接块只修改 inode
+    for (int pg = 0; pg < NDIRECT; pg++)
+    {
+        memset(buf, 'a' + pg, BSIZE);
+        assert(writei(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+    }
+    iflush(ip);
+    log_force();
+
+    // 之后每页单独写回，都修改同一个间接块与 inode 块：每个操作登记一次，组内被吸收
+    int ops0 = log_op_count();
+    int commits0 = log_commit_count();
+    int blocks0 = log_block_count();
+    const int nops = 3 * LOGGROUP;
+    for (int pg = NDIRECT; pg < NDIRECT + nops; pg++)
+    {
+        memset(buf, 'a' + (pg % 26), BSIZE);
+        assert(writei(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+        iflush(ip);
+    }
+    log_force();
+    int ops = log_op_count() - ops0;
+    int commits = log_commit_count() - commits0;
+    int blocks = log_block_count() - blocks0;
+    printf("ops=%d commits=%d logged blocks=%d\n", ops, commits, blocks);
+    assert(ops == nops);
+    assert(commits <= nops / LOGGROUP);
+    assert(blocks == 2 * commits);
+
+    // 每次提交都含同样两个块：检查点只安装最新版本，其余被吸收
+    int inst0 = log_ckpt_installs();
+    log_checkpoint();
+    printf("checkpoint: installed=%d absorbed=%d\n", log_ckpt_installs() - inst0, log_ckpt_absorbed());
+    assert(log_ckpt_installs() - inst0 == 2);
+    assert(log_ckpt_absorbed() >= 2 * (commits - 1));
+
+    // 安装后间接块已在原位置，缓存丢弃后仍能读回
+    pcache_drop(ip);
+    for (int pg = 0; pg < NDIRECT + nops; pg++)
+    {
+        assert(readi(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+        assert(buf[0] == 'a' + (pg < NDIRECT ? pg : pg % 26));
+    }
+
+    // 延迟上限：组未满，但第一个块登记已超过 LOG_COMMIT_DELAY，下一次 end_op 即提交
+    commits0 = log_commit_count();
+    begin_op();
+    iupdate(ip);
+    end_op();
+    assert(log_commit_count() == commits0);
+    uint64 t0 = get_time();
+    while (get_time() - t0 < LOG_COMMIT_DELAY)
+        ;
+    begin_op();
+    end_op();
+    printf("commit after delay: commits delta=%d\n", log_commit_count() - commits0);
+    assert(log_commit_count() == commits0 + 1);
+
+    free_page(buf);
+    ip->nlink = 0;
+    iput(ip);
+    printf("test_log_group_commit passed\n");
+}
+
+void test_inode_cache(void)
+{
+    consoleinit();
+    printf("Testing on-disk inodes and inode cache...\n");
+    pmem_init();
+    fs_init();
+
+    int free0 = count_free_inodes();
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    assert(count_free_inodes() == free0 - 1);
+    char msg[] = "persistent inode";
+    assert(writei(ip, msg, 0, sizeof(msg)) == sizeof(msg));
+    uint inum = ip->inum;
+    iput(ip); // nlink=1，inode 保留在磁盘上
+
+    // 提交并安装后重新挂载：内存中的 inode 缓存被重建，内容从磁盘 inode 表读回
+    log_checkpoint();
+    fs_init();
+    assert(count_free_inodes() == free0 - 1);
+    ip = iget(0, inum);
+    assert(ip != 0 && ip->type == 1 && ip->size == sizeof(msg));
+    char rbuf[32];
+    assert(readi(ip, rbuf, 0, sizeof(msg)) == sizeof(msg));
+    assert(strcmp(rbuf, msg) == 0);
+
+    // 哈希命中：同一 inode 再次 iget 返回同一缓存项
+    int hits0 = icache_hits();
+    struct inode *ip2 = iget(0, inum);
+    assert(ip2 == ip && icache_hits() == hits0 + 1);
+    iput(ip2);
+
+    // 超过 NINODE 个不同 inode 轮流引用：未被引用的项按 LRU 复用
+    int misses0 = icache_misses();
+    for (int i = 2; i < 2 + 2 * NINODE; i++)
+    {
+        struct inode *t = iget(0, i);
+        assert(t != 0);
+        iput(t);
+    }
+    printf("icache: hits=%d misses=%d\n", icache_hits(), icache_misses() - misses0);
+    assert(ip->inum == inum && ip->ref == 1); // 仍被引用的项不会被复用
+
+    ip->nlink = 0;
+    iput(ip);
+    assert(count_free_inodes() == free0);
+    printf("test_inode_cache passed\n");
+}
+
+// 提交一个修改间接块的事务后模拟崩溃（丢弃缓存后重新挂载日志），
+// corrupt 非零时先破坏该提交的日志槽位。返回恢复后间接块在原位置是否已写入。
+static int log_crash_and_recover(int corrupt)
+{
+    fs_init();
+    struct superblock sb;
+    read_superblock(&sb);
+
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char *buf = (char *)alloc_page();
+    assert(buf != 0);
+    memset(buf, 'x', BSIZE);
+    for (int pg = 0; pg <= NDIRECT; pg++)
+        assert(writei(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+    iflush(ip);
+    log_force(); // 已提交，尚未安装
+    uint ind = ip->addrs[NDIRECT];
+
+    if (corrupt)
+    {
+        // 新挂载的日志从槽位 0 开始
+        memset(buf, 0x5a, BSIZE);
+        disk_write(sb.logstart + 1, buf);
+    }
+
+    binit(); // 崩溃：缓存内容丢失
+    log_init();
+
+    disk_read(ind, buf);
+    int installed = ((uint *)buf)[0] != 0;
+    free_page(buf);
+    return installed;
+}
+
+void test_log_checksum(void)
+{
+    consoleinit();
+    printf("Testing checksummed log commits...\n");
+    pmem_init();
+
+    assert(log_crash_and_recover(0) == 1);
+    printf("intact commit replayed\n");
+    assert(log_crash_and_recover(1) == 0);
+    printf("torn commit discarded\n");
+    printf("test_log_checksum passed\n");
+}
+
+// 在一个目录中连续创建多个文件：目录超过 DIR_LINEAR_MAX 项后转为哈希格式，
+// 每次查找只读索引块和名字所在的桶，创建耗时不随目录大小增长。
+#define DIRTEST_NFILES 128
+
+static void dirtest_name(char *name, int i)
+{
+    name[0] = 'f';
+    name[1] = '0' + i / 100;
+    name[2] = '0' + i / 10 % 10;
+    name[3] = '0' + i % 10;
+    name[4] = 0;
+}
+
+void test_dir_hash(void)
+{
+    consoleinit();
+    printf("Testing hashed directory entries...\n");
+    pmem_init();
+    fs_init();
+
+    int free0 = count_free_inodes();
+    struct inode *dp = create("/dirtest", T_DIR);
+    assert(dp != 0);
+    assert(create("/dirtest", T_DIR) == 0); // 重名
+
+    static uint inums[DIRTEST_NFILES];
+    char path[16] = "/dirtest/";
+    uint64 half[2] = {0, 0};
+    for (int i = 0; i < DIRTEST_NFILES; i++)
+    {
+        dirtest_name(path + 9, i);
+        uint64 t0 = get_time();
+        struct inode *ip = create(path, T_FILE);
+        half[i >= DIRTEST_NFILES / 2] += get_time() - t0;
+        assert(ip != 0);
+        inums[i] = ip->inum;
+        iput(ip);
+    }
+    printf("create: first half %d cycles/file, second half %d cycles/file\n",
+           (int)(half[0] / (DIRTEST_NFILES / 2)), (int)(half[1] / (DIRTEST_NFILES / 2)));
+
+    // 已是哈希格式：分配 inode 与写目录项是同一个事务
+    int ops0 = log_op_count();
+    struct inode *extra = create("/dirtest/extra", T_FILE);
+    assert(extra != 0);
+    assert(log_op_count() - ops0 == 1);
+    iput(extra);
+    assert(dirunlink(dp, "extra") == 0);
+
+    // 每次查找只读索引块和一个桶块
+    int reads0 = dir_blocks_read();
+    char name[DIRSIZ + 1];
+    for (int i = 0; i < DIRTEST_NFILES; i++)
+    {
+        dirtest_name(name, i);
+        struct inode *ip = dirlookup(dp, name, 0);
+        assert(ip != 0 && ip->inum == inums[i]);
+        iput(ip);
+    }
+    assert(dir_blocks_read() - reads0 == 2 * DIRTEST_NFILES);
+    assert(dirlookup(dp, "missing", 0) == 0);
+    dirtest_name(path + 9, 7);
+    struct inode *ip = namei(path);
+    assert(ip != 0 && ip->inum == inums[7]);
+    iput(ip);
+
+    // 重名：桶链上有空位时也不能再次插入已存在的名字
+    for (int i = 0; i < DIRTEST_NFILES; i++)
+    {
+        dirtest_name(name, i);
+        assert(dirlink(dp, name, inums[i]) < 0);
+    }
+
+    // 清理：删除全部文件与目录
+    for (int i = 0; i < DIRTEST_NFILES; i++)
+    {
+        dirtest_name(name, i);
+        assert(dirunlink(dp, name) == 0);
+    }
+    struct inode *root = namei("/");
+    assert(dirunlink(root, "dirtest") == 0);
+    iput(root);
+    iput(dp);
+    assert(count_free_inodes() == free0);
+    printf("test_dir_hash passed\n");
+}
+
+void test_dcache(void)
+{
+    consoleinit();
+    printf("Testing pathname lookup cache...\n");
+    pmem_init();
+    fs_init();
+
+    int free0 = count_free_inodes();
+    struct inode *a = create("/a", T_DIR);
+    struct inode *b = create("/a/b", T_DIR);
+    struct inode *c = create("/a/b/c", T_FILE);
+    assert(a && b && c);
+
+    // 第一次查找读目录并填充缓存，此后同一路径不再读目录
+    struct inode *ip = namei("/a/b/c");
+    assert(ip == c);
+    iput(ip);
+    int reads0 = dir_blocks_read();
+    int hits0 = dcache_hits();
+    for (int i = 0; i < 10; i++)
+    {
+        ip = namei("/a/b/c");
+        assert(ip == c);
+        iput(ip);
+    }
+    assert(dir_blocks_read() == reads0);
+    assert(dcache_hits() - hits0 == 30);
+
+    // 负项：不存在的名字第二次查找也不读目录
+    assert(namei("/a/b/none") == 0);
+    reads0 = dir_blocks_read();
+    assert(namei("/a/b/none") == 0);
+    assert(dir_blocks_read() == reads0);
+
+    // dirlink 更新负项，dirunlink 把正项改为负项
+    struct inode *n = create("/a/b/none", T_FILE);
+    assert(n != 0);
+    ip = namei("/a/b/none");
+    assert(ip == n);
+    iput(ip);
+    assert(dirunlink(b, "none") == 0);
+    iput(n);
+    reads0 = dir_blocks_read();
+    assert(namei("/a/b/none") == 0);
+    assert(dir_blocks_read() == reads0);
+    printf("dcache: hits=%d misses=%d\n", dcache_hits(), dcache_misses());
+
+    assert(dirunlink(b, "c") == 0);
+    iput(c);
+    assert(dirunlink(a, "b") == 0);
+    iput(b);
+    struct inode *root = namei("/");
+    assert(dirunlink(root, "a") == 0);
+    iput(root);
+    iput(a);
+    assert(namei("/a/b/c") == 0);
+    assert(count_free_inodes() == free0);
+    printf("test_dcache passed\n");
+}
+
+// 两个文件交替追加写：延迟分配在写回时为每个文件的整段脏页分配连续的块
+void test_delayed_alloc(void)
+{
+    consoleinit();
+    printf("Testing delayed block allocation...\n");
+    pmem_init();
+    fs_init();
+
+    // 两个文件的脏页合计不超过 NDIRTYMAX，且都用到间接块
+    const int npages = NDIRECT + 2;
+    struct inode *a = ialloc(0, T_FILE);
+    struct inode *b = ialloc(0, T_FILE);
+    assert(a != 0 && b != 0);
+    char *buf = (char *)alloc_page();
+    assert(buf != 0);
+    // 日志中尚未安装的块不算空闲
+    log_checkpoint();
+    int free0 = count_free_blocks();
+    int calls0 = balloc_count();
+    for (int pg = 0; pg < npages; pg++)
+    {
+        memset(buf, 'a' + pg, BSIZE);
+        assert(writei(a, buf, pg * BSIZE, BSIZE) == BSIZE);
+        memset(buf, 'A' + pg, BSIZE);
+        assert(writei(b, buf, pg * BSIZE, BSIZE) == BSIZE);
+    }
+    // 写入时尚未分配任何块
+    assert(balloc_count() == calls0);
+    assert(bmap_peek(a, 0) == 0);
+    assert(iflush(a) == 0 && iflush(b) == 0);
+    printf("balloc calls=%d for %d pages\n", balloc_count() - calls0, 2 * npages);
+    assert(balloc_count() - calls0 <= 4); // 每个文件一段数据加一个间接块
+
+    // 每个文件的数据块连续
+    for (int pg = 1; pg < npages; pg++)
+    {
+        assert(bmap_peek(a, pg) == bmap_peek(a, pg - 1) + 1);
+        assert(bmap_peek(b, pg) == bmap_peek(b, pg - 1) + 1);
+    }
+
+    // 丢弃缓存后从磁盘读回
+    pcache_drop(a);
+    pcache_drop(b);
+    for (int pg = 0; pg < npages; pg++)
+    {
+        assert(readi(a, buf, pg * BSIZE, BSIZE) == BSIZE && buf[0] == 'a' + pg);
+        assert(readi(b, buf, pg * BSIZE, BSIZE) == BSIZE && buf[BSIZE - 1] == 'A' + pg);
+    }
+    free_page(buf);
+    a->nlink = 0;
+    iput(a);
+    b->nlink = 0;
+    iput(b);
+    log_checkpoint();
+    assert(count_free_blocks() == free0);
+    printf("test_delayed_alloc passed\n");
+}
+
+// 超出一级间接块范围的文件：写回、重新挂载后经二级间接块读回
+void test_double_indirect(void)
+{
+    consoleinit();
+    printf("Testing double-indirect blocks...\n");
+    pmem_init();
+    fs_init();
+
+    const int npages = NDIRECT + NINDIRECT + 4;
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char *buf = (char *)alloc_page();
+    assert(buf != 0);
+    log_checkpoint();
+    int free0 = count_free_blocks();
+    for (int pg = 0; pg < npages; pg++)
+    {
+        memset(buf, 0, BSIZE);
+        *(int *)buf = pg;
+        assert(writei(ip, buf, pg * BSIZE, BSIZE) == BSIZE);
+    }
+    assert(iflush(ip) == 0);
+    assert(ip->addrs[NDIRECT + 1] != 0 && ip->addrs[NDIRECT + 2] == 0);
+    // 间接表先于各段数据分配：数据块只在开始需要新表的那一段之前断开
+    int gaps = 0;
+    for (int pg = 1; pg < npages; pg++)
+    {
+        if (bmap_peek(ip, pg) != bmap_peek(ip, pg - 1) + 1)
+            gaps++;
+    }
+    printf("data block discontinuities: %d\n", gaps);
+    assert(gaps <= 2);
+    uint inum = ip->inum;
+    iput(ip);
+
+    log_checkpoint();
+    fs_init();
+    ip = iget(0, inum);
+    assert(ip->size == (uint)npages * BSIZE);
+    int hits0 = indcache_hits();
+    for (int pg = NDIRECT; pg < npages; pg++)
+    {
+        assert(readi(ip, buf, pg * BSIZE, sizeof(int)) == sizeof(int));
+        assert(*(int *)buf == pg);
+    }
+    printf("indirect cache hits=%d\n", indcache_hits() - hits0);
+    free_page(buf);
+    ip->nlink = 0;
+    iput(ip);
+    log_checkpoint();
+    assert(count_free_blocks() == free0);
+    printf("test_double_indirect passed\n");
+}
+
+// 小文件内联在 inode 中，长大后才转为块映射
+void test_inline_data(void)
+{
+    consoleinit();
+    printf("Testing inline data for tiny files...\n");
+    pmem_init();
+    fs_init();
+
+    int calls0 = balloc_count();
+    int writes0 = disk_write_count();
+    struct inode *ip = ialloc(0, T_FILE);
+    assert(ip != 0);
+    char msg[] = "tiny file kept in the inode";
+    assert(writei(ip, msg, 0, sizeof(msg)) == sizeof(msg));
+    uint inum = ip->inum;
+    iput(ip);
+
+    // 重新挂载后从 inode 读回；整个过程没有分配或写入数据块
+    log_checkpoint();
+    fs_init();
+    ip = iget(0, inum);
+    assert(ip->size == sizeof(msg));
+    char rbuf[64];
+    assert(readi(ip, rbuf, 0, sizeof(rbuf)) == sizeof(msg));
+    assert(strcmp(rbuf, msg) == 0);
+    assert(balloc_count() == calls0);
+    printf("disk writes=%d (log and inode blocks only)\n", disk_write_count() - writes0);
+
+    // 追加超过 INLINE_MAX：内容移入数据块
+    char more[64];
+    memset(more, 'm', sizeof(more));
+    assert(writei(ip, more, ip->size, sizeof(more)) == sizeof(more));
+    assert(iflush(ip) == 0);
+    assert(balloc_count() == calls0 + 1 && ip->addrs[0] != 0);
+    pcache_drop(ip);
+    assert(readi(ip, rbuf, 0, sizeof(msg)) == sizeof(msg));
+    assert(strcmp(rbuf, msg) == 0);
+    assert(readi(ip, rbuf, sizeof(msg), sizeof(more)) == sizeof(more) && rbuf[sizeof(more) - 1] == 'm');
+
+    ip->nlink = 0;
+    iput(ip);
+    printf("test_inline_data passed\n");
+}
+
+void test_file_vectored(void)
+{
+    consoleinit();
+    printf("Testing pread/pwrite and readv/writev...\n");
+    pmem_init();
+    fs_init();
+    fileinit();
+
+    struct file *f = filealloc();
+    assert(f != 0);
+    f->type = FD_INODE;
+    f->ip = ialloc(0, T_FILE);
+    assert(f->ip != 0);
+    f->readable = 1;
+    f->writable = 1;
+
+    // writev：一次调用写入记录头与记录体
+    char hdr[8] = "HDR0001:";
+    char body[100];
+    memset(body, 'b', sizeof(body));
+    struct iovec wv[2] = {{hdr, sizeof(hdr)}, {body, sizeof(body)}};
+    assert(filewritev(f, wv, 2) == sizeof(hdr) + sizeof(body));
+    assert(f->off == sizeof(hdr) + sizeof(body));
+
+    // pwrite/pread 不改变 f->off
+    assert(filepwrite(f, "XY", 2, 4) == 2);
+    char buf[16];
+    assert(filepread(f, buf, 8, 0) == 8);
+    assert(memcmp(buf, "HDR0XY1:", 8) == 0);
+    assert(f->off == sizeof(hdr) + sizeof(body));
+    assert(filepread(f, buf, 8, f->off) == 0); // 文件末尾
+
+    // readv：按段分散读回，文件末尾处提前结束
+    char rhdr[8], rbody[60], rrest[60];
+    struct iovec rv[3] = {{rhdr, sizeof(rhdr)}, {rbody, sizeof(rbody)}, {rrest, sizeof(rrest)}};
+    f->off = 0;
+    assert(filereadv(f, rv, 3) == sizeof(hdr) + sizeof(body));
+    assert(memcmp(rhdr, "HDR0XY1:", 8) == 0);
+    assert(rbody[0] == 'b' && rrest[sizeof(body) - sizeof(rbody) - 1] == 'b');
+
+    f->ip->nlink = 0;
+    fileclose(f);
+    printf("test_file_vectored passed\n");
+}
+
+static int bio_test_done;
+static void bio_test_endio(struct buf *b)
+{
+    bio_test_done++;
+}
+
+void test_bio_async(void)
+{
+    consoleinit();
+    printf("Testing asynchronous block I/O...\n");
+    pmem_init();
+    binit();
+
+    // 乱序提交 8 个相邻块的写请求，应被排序并合并为一个设备请求；
+    // 使用磁盘末尾的保留块，不碰文件系统
+    static struct buf bs[8];
+    uint scratch = virtio_disk_nblocks() - SCRATCHBLOCKS;
+    char *pages[8];
+    for (int i = 0; i < 8; i++)
+    {
+        pages[i] = (char *)alloc_page();
+        assert(pages[i] != 0);
+    }
+    int req0 = bio_request_count();
+    int merge0 = bio_merge_count();
+    bio_test_done = 0;
+    for (int k = 0; k < 8; k++)
+    {
+        int i = (k * 3) % 8;
+        memset(pages[i], 'A' + i, BSIZE);
+        bio_initbuf(&bs[i], scratch + i, pages[i]);
+        bio_submit(&bs[i], BIO_WRITE, bio_test_endio);
+    }
+    bio_flush();
+    for (int i = 0; i < 8; i++)
+        bio_wait(&bs[i]);
+    assert(bio_test_done == 8);
+    assert(bio_request_count() - req0 == 1);
+    assert(bio_merge_count() - merge0 == 7);
+
+    // 同步读回校验
+    for (int i = 0; i < 8; i++)
+    {
+        memset(pages[i], 0, BSIZE);
+        disk_read(scratch + i, pages[i]);
+        assert(pages[i][0] == 'A' + i && pages[i][BSIZE - 1] == 'A' + i);
+        free_page(pages[i]);
+    }
+    printf("requests=%d merged=%d\n", bio_request_count() - req0, bio_merge_count() - merge0);
+    printf("test_bio_async passed\n");
+}
+
 // 更具体的测试：包含不同级别、长消息、边界覆盖与多次导出
 static __attribute__((unused)) void klog_functional_test(void)
 {
@@ -3,54 +3,33 @@
 #include "printf.h"
 #include "spinlock.h"
 #include "defs.h"
+#include "riscv.h"
+#include "proc.h"
+#include "bqueue.h"
 #include <stddef.h>
 
-// 简单的有界缓冲区实现，使用 spinlock + sleep/wakeup 实现同步
-#define SBUF_SIZE 1
+// 生产者/消费者示例：经一个有界阻塞队列（bqueue.c）传递整数
+#define SBUF_SIZE 4
 #define PRODUCE_COUNT 10
 
-static int sbuf[SBUF_SIZE];
-static int sbuf_in = 0;
-static int sbuf_out = 0;
-static int sbuf_count = 0;
-static struct spinlock sbuf_lock;
-static int sbuf_not_full_chan;
-static int sbuf_not_empty_chan;
+static struct bqueue sbuf;
 
 void shared_buffer_init(void)
 {
-    initlock(&sbuf_lock, "sbuf_lock");
-    sbuf_in = sbuf_out = sbuf_count = 0;
+    if (bq_init(&sbuf, SBUF_SIZE, "sbuf_lock") < 0)
+        panic("shared_buffer_init");
 }
 
 static void sbuf_put(int val)
 {
-    acquire(&sbuf_lock);
-    while (sbuf_count == SBUF_SIZE)
-    {
-        sleep(&sbuf_not_full_chan, &sbuf_lock);
-    }
-    sbuf[sbuf_in] = val;
-    sbuf_in = (sbuf_in + 1) % SBUF_SIZE;
-    sbuf_count++;
-    wakeup(&sbuf_not_empty_chan);
-    release(&sbuf_lock);
+    bq_put(&sbuf, val);
 }
 
 static int sbuf_get(void)
 {
-    int val;
-    acquire(&sbuf_lock);
-    while (sbuf_count == 0)
-    {
-        sleep(&sbuf_not_empty_chan, &sbuf_lock);
-    }
-    val = sbuf[sbuf_out];
-    sbuf_out = (sbuf_out + 1) % SBUF_SIZE;
-    sbuf_count--;
-    wakeup(&sbuf_not_full_chan);
-    release(&sbuf_lock);
-    return val;
+    uint64 val = 0;
+    bq_get(&sbuf, &val);
+    return (int)val;
 }
 
 void producer_task(void)
@@ -87,8 +66,8 @@ void test_synchronization(void)
     printf("Starting synchronization test\n");
 
     // 初始化缓冲区与必要子系统（物理内存、进程表、陷阱/定时器）
-    shared_buffer_init();
     pmem_init();
+    shared_buffer_init();
     procinit();
     //trap_init();
     //enable_interrupts();
@@ -106,3 +85,223 @@ void test_synchronization(void)
     // 进入调度器以运行创建的进程（scheduler 不返回）
     scheduler();
 }
+
+// 共享内存批量传输基准：生产者与消费者映射同一个 shm 段，
+// 每轮交换整段数据（SHM_BENCH_PAGES 页），每轮只有一次 sleep/wakeup 往返
+#define SHM_BENCH_PAGES 16
+#define SHM_BENCH_ROUNDS 64
+
+static int shm_bench_id;
+static int shm_bench_full; // 0：段为空，生产者可写；1：段已满，消费者可读
+static struct spinlock shm_bench_lock;
+static uint64 shm_bench_start;
+
+// 内核线程没有用户页表，为其创建一个仅用于挂载 shm 段的页表
+static uint64 shm_bench_attach(void)
+{
+    struct proc *p = myproc();
+    if (p->pagetable == 0)
+        p->pagetable = create_pagetable();
+    return shm_attach(p, shm_bench_id);
+}
+
+// 通过本进程页表找到第 i 页（段内物理页不保证连续）
+static uint64 *shm_bench_page(uint64 va, int i)
+{
+    return (uint64 *)walkaddr(myproc()->pagetable, va + (uint64)i * PGSIZE);
+}
+
+void shm_producer_task(void)
+{
+    uint64 va = shm_bench_attach();
+    if (va == 0)
+    {
+        printf("shm_producer: attach failed\n");
+        exit_process(-1);
+    }
+    for (int r = 0; r < SHM_BENCH_ROUNDS; r++)
+    {
+        acquire(&shm_bench_lock);
+        while (shm_bench_full)
+            sleep(&shm_bench_full, &shm_bench_lock);
+        release(&shm_bench_lock);
+
+        for (int i = 0; i < SHM_BENCH_PAGES; i++)
+        {
+            uint64 *w = shm_bench_page(va, i);
+            for (int k = 0; k < PGSIZE / (int)sizeof(uint64); k++)
+                w[k] = r + k;
+        }
+
+        acquire(&shm_bench_lock);
+        shm_bench_full = 1;
+        wakeup(&shm_bench_full);
+        release(&shm_bench_lock);
+    }
+    shm_detach(myproc(), shm_bench_id);
+    exit_process(0);
+}
+
+void shm_consumer_task(void)
+{
+    uint64 va = shm_bench_attach();
+    if (va == 0)
+    {
+        printf("shm_consumer: attach failed\n");
+        exit_process(-1);
+    }
+    uint64 sum = 0;
+    int errors = 0;
+    for (int r = 0; r < SHM_BENCH_ROUNDS; r++)
+    {
+        acquire(&shm_bench_lock);
+        while (!shm_bench_full)
+            sleep(&shm_bench_full, &shm_bench_lock);
+        release(&shm_bench_lock);
+
+        for (int i = 0; i < SHM_BENCH_PAGES; i++)
+        {
+            uint64 *w = shm_bench_page(va, i);
+            if (w[0] != (uint64)r)
+                errors++;
+            for (int k = 0; k < PGSIZE / (int)sizeof(uint64); k++)
+                sum += w[k];
+        }
+
+        acquire(&shm_bench_lock);
+        shm_bench_full = 0;
+        wakeup(&shm_bench_full);
+        release(&shm_bench_lock);
+    }
+    uint64 cycles = get_time() - shm_bench_start;
+    int bytes = SHM_BENCH_ROUNDS * SHM_BENCH_PAGES * PGSIZE;
+    printf("shm bench: %d bytes in %d cycles, %d bytes/wakeup, errors=%d (sum=%d)\n",
+           bytes, (int)cycles, bytes / (2 * SHM_BENCH_ROUNDS), errors, (int)sum);
+    shm_detach(myproc(), shm_bench_id);
+    shm_unlink(shm_bench_id);
+    exit_process(0);
+}
+
+void test_shm_throughput(void)
+{
+    printf("Starting shared memory throughput test\n");
+
+    pmem_init();
+    procinit();
+    initlock(&shm_bench_lock, "shm_bench");
+    shm_bench_full = 0;
+
+    shm_bench_id = shm_open("bench", SHM_BENCH_PAGES);
+    if (shm_bench_id < 0)
+    {
+        printf("test_shm_throughput: shm_open failed\n");
+        return;
+    }
+
+    if (create_process(shm_consumer_task) <= 0)
+        printf("test_shm_throughput: create_process failed for consumer\n");
+    if (create_process(shm_producer_task) <= 0)
+        printf("test_shm_throughput: create_process failed for producer\n");
+
+    shm_bench_start = get_time();
+    scheduler();
+}
+
+// 有界队列扫描基准：容量 × 生产者数 × 消费者数的每种组合各传递 BQB_ITEMS 项，
+// 生产者与消费者按 BQB_BATCH 项一批放入/取出。驱动进程依次创建各组合的工作进程并等待其退出，
+// 报告每秒传递的项数、每项的上下文切换次数与唤醒次数
+#define BQB_ITEMS 4096
+#define BQB_BATCH 8
+
+static const int bqb_caps[] = {1, 8, 64};
+static const int bqb_nworkers[] = {1, 2, 4};
+#define BQB_NCONF ((int)(sizeof(bqb_nworkers) / sizeof(bqb_nworkers[0])))
+
+static struct bqueue bqb_q;
+static int bqb_per_producer;
+static int bqb_producers_left;
+static int bqb_received;
+static uint64 bqb_sum;
+
+void bqb_producer(void)
+{
+    uint64 batch[BQB_BATCH];
+    for (int i = 0; i < bqb_per_producer; i += BQB_BATCH)
+    {
+        int n = bqb_per_producer - i < BQB_BATCH ? bqb_per_producer - i : BQB_BATCH;
+        for (int k = 0; k < n; k++)
+            batch[k] = i + k + 1;
+        bq_putn(&bqb_q, batch, n);
+    }
+    // 最后一个退出的生产者关闭队列，消费者取空后结束
+    if (__sync_sub_and_fetch(&bqb_producers_left, 1) == 0)
+        bq_close(&bqb_q);
+}
+
+void bqb_consumer(void)
+{
+    uint64 batch[BQB_BATCH];
+    uint64 sum = 0;
+    int n, count = 0;
+    while ((n = bq_getn(&bqb_q, batch, BQB_BATCH)) > 0)
+    {
+        for (int k = 0; k < n; k++)
+            sum += batch[k];
+        count += n;
+    }
+    __sync_fetch_and_add(&bqb_received, count);
+    __sync_fetch_and_add(&bqb_sum, sum);
+}
+
+void bqb_driver(void)
+{
+    for (int c = 0; c < (int)(sizeof(bqb_caps) / sizeof(bqb_caps[0])); c++)
+    {
+        for (int pi = 0; pi < BQB_NCONF; pi++)
+        {
+            for (int ci = 0; ci < BQB_NCONF; ci++)
+            {
+                int np = bqb_nworkers[pi], nc = bqb_nworkers[ci];
+                if (bq_init(&bqb_q, bqb_caps[c], "bqb") < 0)
+                    panic("bqb_driver: bq_init");
+                bqb_per_producer = BQB_ITEMS / np;
+                bqb_producers_left = np;
+                bqb_received = 0;
+                bqb_sum = 0;
+
+                int sw0 = sched_switches();
+                uint64 t0 = get_time();
+                for (int i = 0; i < nc; i++)
+                    create_process(bqb_consumer);
+                for (int i = 0; i < np; i++)
+                    create_process(bqb_producer);
+                for (int i = 0; i < np + nc; i++)
+                    wait_process(0);
+                uint64 cycles = get_time() - t0;
+                int sw = sched_switches() - sw0;
+
+                uint64 expect = (uint64)np * bqb_per_producer * (bqb_per_producer + 1) / 2;
+                if (bqb_received != np * bqb_per_producer || bqb_sum != expect)
+                    printf("bqueue bench: cap=%d P=%d C=%d lost items (%d received)\n",
+                           bqb_caps[c], np, nc, bqb_received);
+                // qemu virt 时钟 10MHz：items/s = items * 10^7 / cycles；切换次数以百分之一为单位打印
+                int per100 = bqb_received ? sw * 100 / bqb_received : 0;
+                printf("bqueue cap=%d P=%d C=%d: %d items/s, %d.%02d switches/item, %d wakeups\n",
+                       bqb_caps[c], np, nc, cycles ? (int)((uint64)bqb_received * 10000000 / cycles) : 0,
+                       per100 / 100, per100 % 100, bqb_q.wakeups);
+                bq_destroy(&bqb_q);
+            }
+        }
+    }
+    printf("bqueue bench: done\n");
+}
+
+void test_bqueue_sweep(void)
+{
+    printf("Starting bounded queue sweep\n");
+    pmem_init();
+    procinit();
+    if (create_process(bqb_driver) <= 0)
+        printf("test_bqueue_sweep: create_process failed for driver\n");
+    scheduler();
+}
@@ -5,6 +5,29 @@
 #include "printf.h"
 #include "syscall.h"
 #include "log.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+#include "futex.h"
+#include "vm.h"
+
+// 用户页 va0 的物理地址，write 非零时要求可写。内核不经用户页表访问用户内存，
+// 不会触发缺页，所以 mmap 区域中尚未映射的页（或写入只读共享的私有映射页）
+// 在这里显式调用 mmap_fault 建立映射，效果与用户态访问触发缺页相同
+static uint64 uvm_page(pagetable_t pagetable, uint64 va0, int write)
+{
+    struct proc *p = myproc();
+    pte_t *pte = walk_lookup(pagetable, va0);
+    if ((pte == 0 || !(*pte & PTE_V) || (write && !(*pte & PTE_W))) && p && pagetable == p->pagetable)
+    {
+        if (mmap_fault(p, va0, write) < 0)
+            return 0;
+        pte = walk_lookup(pagetable, va0);
+    }
+    if (pte == 0 || !(*pte & PTE_V) || (write && !(*pte & PTE_W)))
+        return 0;
+    return PTE2PA(*pte);
+}
 
 // helper: copy data from user virtual address into kernel buffer
 static int
@@ -17,7 +40,7 @@ copyin_user(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
         va0 = PGROUNDDOWN(srcva);
         if (va0 >= MAXVA)
             return -1;
-        pa0 = walkaddr(pagetable, va0);
+        pa0 = uvm_page(pagetable, va0, 0);
         if (pa0 == 0)
             return -1;
         n = PGSIZE - (srcva - va0);
@@ -41,7 +64,7 @@ copyout_user(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
         va0 = PGROUNDDOWN(dstva);
         if (va0 >= MAXVA)
             return -1;
-        pa0 = walkaddr(pagetable, va0);
+        pa0 = uvm_page(pagetable, va0, 1);
         if (pa0 == 0)
             return -1;
         n = PGSIZE - (dstva - va0);
@@ -65,7 +88,7 @@ copyinstr_user(pagetable_t pagetable, char *buf, uint64 srcva, int max)
         uint64 va0 = PGROUNDDOWN(srcva + i);
         if (va0 >= MAXVA)
             return -1;
-        uint64 pa0 = walkaddr(pagetable, va0);
+        uint64 pa0 = uvm_page(pagetable, va0, 0);
         if (pa0 == 0)
             return -1;
         char *p = (char *)(pa0 + ((srcva + i) - va0));
@@ -130,16 +153,71 @@ int argstr(int n, char *buf, int max)
 // syscall implementations
 extern void consputc(int);
 
+// 在文件与用户缓冲区之间传输 n 字节，经一页内核缓冲区分块进行。
+// off 为 -1 时使用并推进 f->off，否则在 off 处读写（pread/pwrite）。
+static int
+file_xfer(struct file *f, uint64 addr, int n, int write, int off)
+{
+    if (n < 0)
+        return -1;
+    char *kbuf = (char *)alloc_page();
+    if (kbuf == 0)
+        return -1;
+    pagetable_t pt = myproc()->pagetable;
+    int tot = 0;
+    while (tot < n)
+    {
+        int chunk = n - tot > PGSIZE ? PGSIZE : n - tot;
+        int r;
+        if (write)
+        {
+            if (copyin_user(pt, kbuf, addr + tot, chunk) < 0)
+                break;
+            r = off < 0 ? filewrite(f, kbuf, chunk) : filepwrite(f, kbuf, chunk, off + tot);
+        }
+        else
+        {
+            r = off < 0 ? fileread(f, kbuf, chunk) : filepread(f, kbuf, chunk, off + tot);
+            if (r > 0 && copyout_user(pt, addr + tot, kbuf, r) < 0)
+                r = -1;
+        }
+        if (r < 0)
+        {
+            if (tot == 0)
+                tot = -1;
+            break;
+        }
+        tot += r;
+        if (r < chunk)
+            break;
+    }
+    free_page(kbuf);
+    return tot;
+}
+
+static struct file *
+argfd(int n, int *pfd)
+{
+    int fd;
+    argint(n, &fd);
+    if (pfd)
+        *pfd = fd;
+    return fdget(myproc(), fd);
+}
+
 static uint64
 sys_write(void)
 {
     int fd;
     uint64 addr;
     int n;
-    argint(0, &fd);
+    struct file *f = argfd(0, &fd);
     argaddr(1, &addr);
     argint(2, &n);
 
+    if (f)
+        return file_xfer(f, addr, n, 1, -1);
+    // 未打开的 fd 1/2 仍直接输出到控制台
     if (fd != 1 && fd != 2)
         return -1;
 
@@ -219,6 +297,342 @@ sys_klog(void)
     return r;
 }
 
+static uint64
+sys_shmget(void)
+{
+    char name[16];
+    int npages;
+    if (argstr(0, name, sizeof(name)) < 0)
+        return -1;
+    argint(1, &npages);
+    return shm_open(name, npages);
+}
+
+static uint64
+sys_shmat(void)
+{
+    int id;
+    argint(0, &id);
+    uint64 va = shm_attach(myproc(), id);
+    klog(LOG_LEVEL_DEBUG, "sys_shmat: pid=%d id=%d va=%p", myproc()->pid, id, (void *)va);
+    return va ? va : -1;
+}
+
+static uint64
+sys_shmdt(void)
+{
+    int id;
+    argint(0, &id);
+    return shm_detach(myproc(), id);
+}
+
+static uint64
+sys_open(void)
+{
+    char path[MAXPATH];
+    int omode;
+    if (argstr(0, path, sizeof(path)) < 0)
+        return -1;
+    argint(1, &omode);
+
+    // 先查找，名字不存在且带 O_CREATE 时才创建，打开已有文件不会分配 inode
+    struct inode *ip = namei(path);
+    if (ip == 0 && (omode & O_CREATE))
+    {
+        // 创建失败可能是其间已被他人创建，再查找一次
+        if ((ip = create(path, T_FILE)) == 0)
+            ip = namei(path);
+    }
+    if (ip == 0)
+        return -1;
+    if (ip->type == T_DIR && (omode & (O_WRONLY | O_RDWR)))
+    {
+        iput(ip);
+        return -1;
+    }
+
+    struct file *f = filealloc();
+    int fd;
+    if (f == 0 || (fd = fdalloc(myproc(), f)) < 0)
+    {
+        if (f)
+            fileclose(f);
+        iput(ip);
+        return -1;
+    }
+    f->type = FD_INODE;
+    f->ip = ip;
+    f->readable = !(omode & O_WRONLY);
+    f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+    klog(LOG_LEVEL_DEBUG, "sys_open: pid=%d path=%s fd=%d", myproc()->pid, path, fd);
+    return fd;
+}
+
+static uint64
+sys_read(void)
+{
+    uint64 addr;
+    int n;
+    struct file *f = argfd(0, 0);
+    argaddr(1, &addr);
+    argint(2, &n);
+    if (f == 0)
+        return -1;
+    return file_xfer(f, addr, n, 0, -1);
+}
+
+static uint64
+sys_close(void)
+{
+    int fd;
+    argint(0, &fd);
+    return fdclose(myproc(), fd);
+}
+
+static uint64
+sys_dup(void)
+{
+    struct file *f = argfd(0, 0);
+    if (f == 0)
+        return -1;
+    int fd = fdalloc(myproc(), f);
+    if (fd < 0)
+        return -1;
+    filedup(f);
+    return fd;
+}
+
+static uint64
+sys_pread(void)
+{
+    uint64 addr;
+    int n, off;
+    struct file *f = argfd(0, 0);
+    argaddr(1, &addr);
+    argint(2, &n);
+    argint(3, &off);
+    if (f == 0 || off < 0)
+        return -1;
+    return file_xfer(f, addr, n, 0, off);
+}
+
+static uint64
+sys_pwrite(void)
+{
+    uint64 addr;
+    int n, off;
+    struct file *f = argfd(0, 0);
+    argaddr(1, &addr);
+    argint(2, &n);
+    argint(3, &off);
+    if (f == 0 || off < 0)
+        return -1;
+    return file_xfer(f, addr, n, 1, off);
+}
+
+// readv/writev：取回用户的 iovec 数组，各段经一页内核缓冲区成批交给 filereadv/filewritev。
+// 一批中各段的切片依次排在缓冲区里（至多 IOV_MAX 段），超过一页的段被拆到多批中
+static uint64
+sys_rwv(int write)
+{
+    uint64 uiov;
+    int iovcnt;
+    struct file *f = argfd(0, 0);
+    argaddr(1, &uiov);
+    argint(2, &iovcnt);
+    if (f == 0 || iovcnt < 0 || iovcnt > IOV_MAX)
+        return -1;
+    pagetable_t pt = myproc()->pagetable;
+    struct iovec iov[IOV_MAX];
+    if (copyin_user(pt, (char *)iov, uiov, iovcnt * sizeof(struct iovec)) < 0)
+        return -1;
+    char *kbuf = (char *)alloc_page();
+    if (kbuf == 0)
+        return -1;
+
+    struct iovec kv[IOV_MAX];
+    uint64 uaddr[IOV_MAX];
+    int tot = 0, seg = 0;
+    uint segoff = 0;
+    while (seg < iovcnt)
+    {
+        // 装一批：kv[k] 指向缓冲区中的切片，uaddr[k] 是它对应的用户地址
+        int nk = 0;
+        uint used = 0;
+        int err = 0;
+        while (seg < iovcnt && nk < IOV_MAX && used < PGSIZE)
+        {
+            uint len = iov[seg].iov_len - segoff;
+            if (len > PGSIZE - used)
+                len = PGSIZE - used;
+            kv[nk].iov_base = kbuf + used;
+            kv[nk].iov_len = len;
+            uaddr[nk] = (uint64)iov[seg].iov_base + segoff;
+            if (write && copyin_user(pt, kbuf + used, uaddr[nk], len) < 0)
+            {
+                err = 1;
+                break;
+            }
+            used += len;
+            nk++;
+            segoff += len;
+            if (segoff == iov[seg].iov_len)
+            {
+                seg++;
+                segoff = 0;
+            }
+        }
+        if (err && nk == 0)
+        {
+            if (tot == 0)
+                tot = -1;
+            break;
+        }
+
+        int r = write ? filewritev(f, kv, nk) : filereadv(f, kv, nk);
+        if (r < 0)
+        {
+            if (tot == 0)
+                tot = -1;
+            break;
+        }
+        if (!write)
+        {
+            int left = r;
+            for (int k = 0; k < nk && left > 0; k++)
+            {
+                int m = (int)kv[k].iov_len < left ? (int)kv[k].iov_len : left;
+                if (copyout_user(pt, uaddr[k], kv[k].iov_base, m) < 0)
+                {
+                    err = 1;
+                    r -= left;
+                    break;
+                }
+                left -= m;
+            }
+        }
+        tot += r;
+        if (err || r < (int)used)
+            break;
+    }
+    free_page(kbuf);
+    return tot;
+}
+
+static uint64
+sys_readv(void)
+{
+    return sys_rwv(0);
+}
+
+static uint64
+sys_writev(void)
+{
+    return sys_rwv(1);
+}
+
+// mmap(addr, len, prot, flags, fd, off)：addr 仅作提示，被忽略
+static uint64
+sys_mmap(void)
+{
+    uint64 len;
+    int prot, flags, off;
+    argaddr(1, &len);
+    argint(2, &prot);
+    argint(3, &flags);
+    struct file *f = argfd(4, 0);
+    argint(5, &off);
+    if (f == 0 || f->type != FD_INODE || off < 0 || !f->readable)
+        return -1;
+    uint64 va = mmap_file(myproc(), f->ip, off, len, prot, flags);
+    return va ? va : -1;
+}
+
+static uint64
+sys_munmap(void)
+{
+    uint64 va, len;
+    argaddr(0, &va);
+    argaddr(1, &len);
+    return munmap_file(myproc(), va, len);
+}
+
+// sendfile(out_fd, in_fd, off, n)：off 为 -1 时从 in 的当前偏移发送并推进偏移。
+// 数据直接从页缓存页写到输出端，不复制到用户空间；未打开的 fd 1/2 输出到控制台
+static uint64
+sys_sendfile(void)
+{
+    int outfd, off, n;
+    struct file *out = argfd(0, &outfd);
+    struct file *in = argfd(1, 0);
+    argint(2, &off);
+    argint(3, &n);
+    if (in == 0 || in->type != FD_INODE || (out == 0 && outfd != 1 && outfd != 2))
+        return -1;
+    if (off >= 0)
+        return filesend(out, in, off, n);
+    int r = filesend(out, in, in->off, n);
+    if (r > 0)
+        in->off += r;
+    return r;
+}
+
+// pipe(fds)：fds[0] 为读端，fds[1] 为写端
+static uint64
+sys_pipe(void)
+{
+    uint64 fdarray;
+    argaddr(0, &fdarray);
+    struct proc *p = myproc();
+    struct file *rf, *wf;
+    if (pipealloc(&rf, &wf) < 0)
+        return -1;
+    int fds[2];
+    fds[0] = fdalloc(p, rf);
+    fds[1] = fds[0] < 0 ? -1 : fdalloc(p, wf);
+    if (fds[1] < 0 || copyout_user(p->pagetable, fdarray, (char *)fds, sizeof(fds)) < 0)
+    {
+        // 已分配的 fd 随 file 一起关闭，未分配的 file 直接关闭
+        if (fds[0] >= 0)
+            fdclose(p, fds[0]);
+        else
+            fileclose(rf);
+        if (fds[1] >= 0)
+            fdclose(p, fds[1]);
+        else
+            fileclose(wf);
+        return -1;
+    }
+    return 0;
+}
+
+// futex(uaddr, op, val)：FUTEX_WAIT 在 *uaddr == val 时睡眠，FUTEX_WAKE 唤醒至多 val 个等待者
+static uint64
+sys_futex(void)
+{
+    uint64 uaddr;
+    int op, val;
+    argaddr(0, &uaddr);
+    argint(1, &op);
+    argint(2, &val);
+    pagetable_t pt = myproc()->pagetable;
+    if (op == FUTEX_WAIT)
+        return futex_wait(pt, uaddr, val);
+    if (op == FUTEX_WAKE)
+        return futex_wake(pt, uaddr, val);
+    return -1;
+}
+
+// setpriority(pid, nice)：pid 为 0 表示调用者，nice 为 0（最高）到 NMLFQ-1
+static uint64
+sys_setpriority(void)
+{
+    int pid, nice;
+    argint(0, &pid);
+    argint(1, &nice);
+    return setpriority(pid, nice);
+}
+
 // syscall table
 static uint64 (*syscalls[])(void) = {
     [SYS_write] sys_write,
@@ -227,6 +641,23 @@ static uint64 (*syscalls[])(void) = {
     [SYS_fork] sys_fork,
     [SYS_wait] sys_wait,
     [SYS_klog] sys_klog,
+    [SYS_shmget] sys_shmget,
+    [SYS_shmat] sys_shmat,
+    [SYS_shmdt] sys_shmdt,
+    [SYS_open] sys_open,
+    [SYS_read] sys_read,
+    [SYS_close] sys_close,
+    [SYS_dup] sys_dup,
+    [SYS_pread] sys_pread,
+    [SYS_pwrite] sys_pwrite,
+    [SYS_readv] sys_readv,
+    [SYS_writev] sys_writev,
+    [SYS_mmap] sys_mmap,
+    [SYS_munmap] sys_munmap,
+    [SYS_sendfile] sys_sendfile,
+    [SYS_pipe] sys_pipe,
+    [SYS_futex] sys_futex,
+    [SYS_setpriority] sys_setpriority,
 };
 
 #define NELEM(x) (sizeof(x) / sizeof((x)[0]))
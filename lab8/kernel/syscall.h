@@ -8,6 +8,23 @@
 #define SYS_fork 4
 #define SYS_wait 5
 #define SYS_klog 6
+#define SYS_shmget 7
+#define SYS_shmat 8
+#define SYS_shmdt 9
+#define SYS_open 10
+#define SYS_read 11
+#define SYS_close 12
+#define SYS_dup 13
+#define SYS_pread 14
+#define SYS_pwrite 15
+#define SYS_readv 16
+#define SYS_writev 17
+#define SYS_mmap 18
+#define SYS_munmap 19
+#define SYS_sendfile 20
+#define SYS_pipe 21
+#define SYS_futex 22
+#define SYS_setpriority 23
 
 #endif
 
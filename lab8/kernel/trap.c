@@ -5,6 +5,8 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "printf.h"
+#include "defs.h"
+#include "syscall.h"
 
 // 外部汇编函数声明
 extern void kernelvec(void);
@@ -164,11 +166,23 @@ void kerneltrap(void)
         if (irq == IRQ_S_TIMER || irq == IRQ_S_SOFT)
         {
             timer_interrupt_handler();
-            // 在 timer 中断后触发让出以实现抢占式调度
-            if (myproc() != 0)
+            // 当前进程用满本级时间额度后才让出，实现抢占式调度
+            if (sched_tick())
                 yield();
             return;
         }
+        else if (irq == IRQ_S_EXT)
+        {
+            // 外部中断：向 PLIC 领取中断号，处理后通知完成
+            int dev = plic_claim();
+            if (dev == VIRTIO0_IRQ)
+                virtio_disk_intr();
+            else if (dev)
+                printf("kerneltrap: unexpected plic irq=%d\n", dev);
+            if (dev)
+                plic_complete(dev);
+            return;
+        }
         else
         {
             printf("kerneltrap: unhandled interrupt irq=%d scause=%p sepc=%p\n", irq, scause, sepc);
@@ -177,6 +191,9 @@ void kerneltrap(void)
     }
     else
     {
+        // 内核使用 kernel_pagetable，不会因用户的 mmap 区域缺页：
+        // 系统调用访问用户内存时由 copyin/copyout 显式调用 mmap_fault
+
         // 打印当前 ticks 与当前进程信息（诊断用）
         struct proc *p = myproc();
         int pid = p ? p->pid : 0;
@@ -208,6 +225,10 @@ void trap_init(void)
     // 初始化定时器中断
     timer_init();
 
+    // 外部中断控制器（virtio 磁盘完成中断）
+    plicinit();
+    plicinithart();
+
     // 使能 supervisor 层的各类中断位 (允许被委托的中断在 S 模式下触发)
     // 这里设置 STIE/SSIE/SEIE，确保 supervisor 在 S 模式下可以接收软件/计时器/外部中断
     w_sie(r_sie() | SIE_STIE | SIE_SSIE | SIE_SEIE);
@@ -236,11 +257,83 @@ void mtrap_halt(void)
     }
 }
 
+// 用户态陷阱入口：trampoline.S 的 uservec 保存用户寄存器、切换到内核页表后跳到这里。
+// 处理系统调用、设备与定时器中断，以及用户访问 mmap 区域引起的缺页
+void usertrap(void)
+{
+    if ((r_sstatus() & SSTATUS_SPP) != 0)
+        panic("usertrap: not from user mode");
+    // 之后的陷阱都来自内核
+    w_stvec((uint64)kernelvec);
+
+    struct proc *p = myproc();
+    p->trapframe->epc = r_sepc();
+    uint64 scause = r_scause();
+
+    if (scause == CAUSE_USER_ECALL)
+    {
+        if (p->killed)
+            exit_process(-1);
+        p->trapframe->epc += 4; // 返回到 ecall 的下一条指令
+        intr_on();
+        syscall();
+    }
+    else if (scause & 0x8000000000000000L)
+    {
+        int irq = scause & 0xff;
+        if (irq == IRQ_S_TIMER || irq == IRQ_S_SOFT)
+        {
+            timer_interrupt_handler();
+            if (sched_tick())
+                yield();
+        }
+        else if (irq == IRQ_S_EXT)
+        {
+            int dev = plic_claim();
+            if (dev == VIRTIO0_IRQ)
+                virtio_disk_intr();
+            else if (dev)
+                printf("usertrap: unexpected plic irq=%d\n", dev);
+            if (dev)
+                plic_complete(dev);
+        }
+    }
+    else if ((scause == CAUSE_LOAD_PAGE_FAULT || scause == CAUSE_STORE_PAGE_FAULT ||
+              scause == CAUSE_INSTRUCTION_PAGE_FAULT) &&
+             mmap_fault(p, r_stval(), scause == CAUSE_STORE_PAGE_FAULT) == 0)
+    {
+        // 缺页落在 mmap 区域内，已从页缓存建立映射，返回后重新执行该指令
+    }
+    else
+    {
+        printf("usertrap: unexpected scause=%p pid=%d sepc=%p stval=%p\n",
+               (void *)scause, p->pid, (void *)r_sepc(), (void *)r_stval());
+        p->killed = 1;
+    }
+
+    if (p->killed)
+        exit_process(-1);
+    usertrapret();
+}
+
 // return-to-user path: set up sstatus/sepc/satp and jump to trampoline userret
 void usertrapret(void)
 {
     struct proc *p = myproc();
 
+    // 回到用户态之前关中断，直到 sret；之后的陷阱进入 uservec
+    intr_off();
+    extern char trampoline[];
+    extern char uservec[];
+    w_stvec((uint64)trampoline + ((uint64)uservec - (uint64)trampoline));
+
+    // uservec 下次进入内核时需要的值
+    extern pagetable_t kernel_pagetable;
+    p->trapframe->kernel_satp = MAKE_SATP(kernel_pagetable);
+    p->trapframe->kernel_sp = (uint64)p->trapframe; // trapframe 位于内核栈页顶端，栈在其下方
+    p->trapframe->kernel_trap = (uint64)usertrap;
+    p->trapframe->kernel_hartid = 0; // 单 CPU
+
     // set S Previous Privilege mode to User, enable interrupts in user mode
     uint64 x = r_sstatus();
     x &= ~SSTATUS_SPP; // clear SPP to 0 for user mode
@@ -253,7 +346,6 @@ void usertrapret(void)
     // give the trampoline the user page table to switch to (satp in a0)
     uint64 satp = MAKE_SATP(p->pagetable);
     // compute address of trampoline userret entry
-    extern char trampoline[];
     extern char userret[];
     uint64 userret_addr = (uint64)trampoline + ((uint64)userret - (uint64)trampoline);
 
@@ -0,0 +1,395 @@
+// kernel/virtio_disk.c
+//
+// driver for qemu's virtio disk device.
+// uses qemu's mmio interface to virtio.
+//
+// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
+//
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "virtio.h"
+#include "printf.h"
+
+// the address of virtio mmio register r.
+#define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
+
+// 描述符表与两个环直接放在 BSS 中（内核地址即物理地址），
+// 不依赖物理页分配器，fs_init 可以在 pmem_init 之前调用。
+static struct virtq_desc vdesc[NUM] __attribute__((aligned(PGSIZE)));
+static struct virtq_avail vavail __attribute__((aligned(PGSIZE)));
+static struct virtq_used vused __attribute__((aligned(PGSIZE)));
+
+static struct disk
+{
+    // a set (not a ring) of DMA descriptors, with which the
+    // driver tells the device where to read and write individual
+    // disk operations. most commands consist of a "chain" (a linked
+    // list) of three descriptors.
+    struct virtq_desc *desc;
+
+    // a ring in which the driver writes descriptor numbers
+    // that the driver would like the device to process.
+    struct virtq_avail *avail;
+
+    // a ring in which the device writes descriptor numbers that
+    // the device has finished processing (disk requests).
+    struct virtq_used *used;
+
+    // our own book-keeping.
+    char free[NUM];  // is a descriptor free?
+    uint16 used_idx; // we've looked this far in used[2..NUM].
+
+    // track info about in-flight operations,
+    // for use when completion interrupt arrives.
+    // indexed by first descriptor index of chain.
+    struct
+    {
+        struct vreq *r;
+        char status;
+    } info[NUM];
+
+    // disk command headers.
+    // one-for-one with descriptors, for convenience.
+    struct virtio_blk_req ops[NUM];
+
+    int inflight;     // 当前在设备中的请求数
+    int max_inflight; // 观测到的最大并发请求数
+    uint64 capacity;  // 磁盘容量（512 字节扇区）
+
+    struct spinlock vdisk_lock;
+} disk;
+
+static int virtio_inited = 0;
+
+void virtio_disk_init(void)
+{
+    uint32 status = 0;
+
+    if (virtio_inited)
+        return;
+    virtio_inited = 1;
+
+    initlock(&disk.vdisk_lock, "virtio_disk");
+
+    if (*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
+        *R(VIRTIO_MMIO_VERSION) != 2 ||
+        *R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
+        *R(VIRTIO_MMIO_VENDOR_ID) != 0x554d4551)
+    {
+        panic("could not find virtio disk");
+    }
+
+    // reset device
+    *R(VIRTIO_MMIO_STATUS) = status;
+
+    // set ACKNOWLEDGE status bit
+    status |= VIRTIO_CONFIG_S_ACKNOWLEDGE;
+    *R(VIRTIO_MMIO_STATUS) = status;
+
+    // set DRIVER status bit
+    status |= VIRTIO_CONFIG_S_DRIVER;
+    *R(VIRTIO_MMIO_STATUS) = status;
+
+    // negotiate features
+    uint64 features = *R(VIRTIO_MMIO_DEVICE_FEATURES);
+    features &= ~(1 << VIRTIO_BLK_F_RO);
+    features &= ~(1 << VIRTIO_BLK_F_SCSI);
+    features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
+    features &= ~(1 << VIRTIO_BLK_F_MQ);
+    features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
+    features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
+    features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
+    *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+
+    // 容量由磁盘镜像大小决定
+    disk.capacity = *R(VIRTIO_MMIO_CONFIG) | ((uint64)*R(VIRTIO_MMIO_CONFIG + 4) << 32);
+
+    // tell device that feature negotiation is complete.
+    status |= VIRTIO_CONFIG_S_FEATURES_OK;
+    *R(VIRTIO_MMIO_STATUS) = status;
+
+    // re-read status to ensure FEATURES_OK is set.
+    status = *R(VIRTIO_MMIO_STATUS);
+    if (!(status & VIRTIO_CONFIG_S_FEATURES_OK))
+        panic("virtio disk FEATURES_OK unset");
+
+    // initialize queue 0.
+    *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
+
+    // ensure queue 0 is not in use.
+    if (*R(VIRTIO_MMIO_QUEUE_READY))
+        panic("virtio disk should not be ready");
+
+    // check maximum queue size.
+    uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
+    if (max == 0)
+        panic("virtio disk has no queue 0");
+    if (max < NUM)
+        panic("virtio disk max queue too short");
+
+    disk.desc = vdesc;
+    disk.avail = &vavail;
+    disk.used = &vused;
+    memset(disk.desc, 0, sizeof(vdesc));
+    memset(disk.avail, 0, sizeof(vavail));
+    memset(disk.used, 0, sizeof(vused));
+
+    // set queue size.
+    *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+
+    // write physical addresses.
+    *R(VIRTIO_MMIO_QUEUE_DESC_LOW) = (uint64)disk.desc;
+    *R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)disk.desc >> 32;
+    *R(VIRTIO_MMIO_DRIVER_DESC_LOW) = (uint64)disk.avail;
+    *R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)disk.avail >> 32;
+    *R(VIRTIO_MMIO_DEVICE_DESC_LOW) = (uint64)disk.used;
+    *R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)disk.used >> 32;
+
+    // queue is ready.
+    *R(VIRTIO_MMIO_QUEUE_READY) = 0x1;
+
+    // all NUM descriptors start out unused.
+    for (int i = 0; i < NUM; i++)
+        disk.free[i] = 1;
+    disk.used_idx = 0;
+    disk.inflight = 0;
+    disk.max_inflight = 0;
+
+    // tell device we're completely ready.
+    status |= VIRTIO_CONFIG_S_DRIVER_OK;
+    *R(VIRTIO_MMIO_STATUS) = status;
+
+    // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+}
+
+// find a free descriptor, mark it non-free, return its index.
+static int alloc_desc(void)
+{
+    for (int i = 0; i < NUM; i++)
+    {
+        if (disk.free[i])
+        {
+            disk.free[i] = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// mark a descriptor as free.
+static void free_desc(int i)
+{
+    if (i >= NUM)
+        panic("free_desc 1");
+    if (disk.free[i])
+        panic("free_desc 2");
+    disk.desc[i].addr = 0;
+    disk.desc[i].len = 0;
+    disk.desc[i].flags = 0;
+    disk.desc[i].next = 0;
+    disk.free[i] = 1;
+    wakeup(&disk.free[0]);
+}
+
+// free a chain of descriptors.
+static void free_chain(int i)
+{
+    while (1)
+    {
+        int flag = disk.desc[i].flags;
+        int nxt = disk.desc[i].next;
+        free_desc(i);
+        if (flag & VRING_DESC_F_NEXT)
+            i = nxt;
+        else
+            break;
+    }
+}
+
+// allocate n descriptors (they need not be contiguous).
+// a disk transfer uses a header, one descriptor per block and a status byte.
+static int alloc_descs(int *idx, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        idx[i] = alloc_desc();
+        if (idx[i] < 0)
+        {
+            for (int j = 0; j < i; j++)
+                free_desc(idx[j]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 处理 used 环中已完成的请求，调用者持有 vdisk_lock
+static void virtio_disk_complete(void)
+{
+    // the device won't raise another interrupt until we tell it
+    // we've seen this interrupt, which the following line does.
+    // this may race with the device writing new entries to
+    // the "used" ring, in which case we may process the new
+    // completion entries in this interrupt, and have nothing to do
+    // in the next interrupt, which is harmless.
+    *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+
+    __sync_synchronize();
+
+    // the device increments disk.used->idx when it
+    // adds an entry to the used ring.
+    while (disk.used_idx != disk.used->idx)
+    {
+        __sync_synchronize();
+        int id = disk.used->ring[disk.used_idx % NUM].id;
+
+        if (disk.info[id].status != 0)
+            panic("virtio_disk_intr status");
+
+        struct vreq *r = disk.info[id].r;
+        disk.info[id].r = 0;
+        free_chain(id);
+        disk.inflight--;
+        r->done = 1; // disk is done with the request
+        if (r->callback)
+            r->callback(r);
+        wakeup(r);
+
+        disk.used_idx += 1;
+    }
+}
+
+// 等待条件期间：有进程上下文且可以开中断时睡眠等待中断，
+// 否则（启动阶段的内核测试、调度器上下文）直接轮询 used 环
+static void virtio_disk_waitfor(void *chan, int can_sleep)
+{
+    if (can_sleep)
+        sleep(chan, &disk.vdisk_lock);
+    else
+        virtio_disk_complete();
+}
+
+// 提交一个请求后立即返回，不等待完成；描述符不足时等待已有请求完成。
+// 多个请求可同时在设备中排队。
+void virtio_disk_submit(struct vreq *r)
+{
+    uint64 sector = r->blockno * (BSIZE / 512);
+    int can_sleep = myproc() != 0 && intr_get();
+
+    if (r->nseg < 1 || r->nseg > VREQ_MAXSEG)
+        panic("virtio_disk_submit: nseg");
+
+    r->done = 0;
+    acquire(&disk.vdisk_lock);
+
+    // allocate the descriptors: header, one per block, status.
+    int n = r->nseg + 2;
+    int idx[VREQ_MAXSEG + 2];
+    while (alloc_descs(idx, n) != 0)
+        virtio_disk_waitfor(&disk.free[0], can_sleep);
+
+    // format the descriptors.
+    struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
+
+    if (r->write)
+        buf0->type = VIRTIO_BLK_T_OUT; // write the disk
+    else
+        buf0->type = VIRTIO_BLK_T_IN; // read the disk
+    buf0->reserved = 0;
+    buf0->sector = sector;
+
+    disk.desc[idx[0]].addr = (uint64)buf0;
+    disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
+    disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
+    disk.desc[idx[0]].next = idx[1];
+
+    for (int i = 0; i < r->nseg; i++)
+    {
+        int d = idx[i + 1];
+        disk.desc[d].addr = (uint64)r->data[i];
+        disk.desc[d].len = BSIZE;
+        if (r->write)
+            disk.desc[d].flags = 0; // device reads r->data
+        else
+            disk.desc[d].flags = VRING_DESC_F_WRITE; // device writes r->data
+        disk.desc[d].flags |= VRING_DESC_F_NEXT;
+        disk.desc[d].next = idx[i + 2];
+    }
+
+    int st = idx[n - 1];
+    disk.info[idx[0]].status = 0xff; // device writes 0 on success
+    disk.desc[st].addr = (uint64)&disk.info[idx[0]].status;
+    disk.desc[st].len = 1;
+    disk.desc[st].flags = VRING_DESC_F_WRITE; // device writes the status
+    disk.desc[st].next = 0;
+
+    // record request for virtio_disk_intr().
+    disk.info[idx[0]].r = r;
+
+    // tell the device the first index in our chain of descriptors.
+    disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+
+    __sync_synchronize();
+
+    // tell the device another avail ring entry is available.
+    disk.avail->idx += 1; // not % NUM ...
+
+    __sync_synchronize();
+
+    disk.inflight++;
+    if (disk.inflight > disk.max_inflight)
+        disk.max_inflight = disk.inflight;
+
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+
+    release(&disk.vdisk_lock);
+}
+
+// 等待已提交的请求完成
+void virtio_disk_wait(struct vreq *r)
+{
+    int can_sleep = myproc() != 0 && intr_get();
+
+    acquire(&disk.vdisk_lock);
+    while (r->done == 0)
+        virtio_disk_waitfor(r, can_sleep);
+    release(&disk.vdisk_lock);
+}
+
+// 同步读写一个磁盘块
+void virtio_disk_rw(uint blockno, void *data, int write)
+{
+    struct vreq r;
+    r.blockno = blockno;
+    r.nseg = 1;
+    r.data[0] = data;
+    r.write = write;
+    r.callback = 0;
+    r.arg = 0;
+    virtio_disk_submit(&r);
+    virtio_disk_wait(&r);
+}
+
+void virtio_disk_intr(void)
+{
+    acquire(&disk.vdisk_lock);
+    virtio_disk_complete();
+    release(&disk.vdisk_lock);
+}
+
+int virtio_disk_max_inflight(void)
+{
+    return disk.max_inflight;
+}
+
+// 磁盘容量（BSIZE 字节的块数）
+uint virtio_disk_nblocks(void)
+{
+    return disk.capacity / (BSIZE / 512);
+}
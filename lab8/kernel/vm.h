@@ -19,9 +19,11 @@ pagetable_t create_pagetable(void);
 int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm);
 int map_page(pagetable_t pagetable, uint64 va, uint64 pa, int perm);
 void unmap_page(pagetable_t pagetable, uint64 va);
+void unmap_range(pagetable_t pagetable, uint64 va, uint64 npages, int do_free);
 void destroy_pagetable(pagetable_t pagetable);
 uint64 walkaddr(pagetable_t pagetable, uint64 va);
 int copy_pagetable_mapping(pagetable_t old, pagetable_t newpt, uint64 va, uint64 size);
+uint64 vm_walk_count(void);
 
 // 内核页表初始化/激活
 void kvminit(void);